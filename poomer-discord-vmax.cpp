@@ -27,8 +27,17 @@
 #include <cstdint> // For fixed-size integer types
 #include <cmath> // For mathematical functions
 #include <map> // For key-value pair data structures
+#include <set> // For counting buckets in --inspect
 #include <variant> // For material properties
 #include <limits> // For std::numeric_limits
+#include <unordered_map> // For vertex welding and node lookups
+#include <functional> // For std::function callbacks
+#include <optional> // For the job-wide scene EventScope
+#include <memory> // For std::shared_ptr in the palette cache
+#include <sstream> // For splitting message text into render options
+#include <deque> // For frames waiting on the encoder pipe
+#include <csignal> // For ignoring SIGPIPE from a dead encoder
+#include <cerrno> // For telling a dead scratch owner from one we may not signal
 
 // Bella Engine SDK - for rendering and scene creation
 #include "../bella_engine_sdk/src/bella_sdk/bella_scene.h" // For creating and manipulating 3D scenes in Bella
@@ -39,8 +48,13 @@
 #include <windows.h> // For ShellExecuteW
 #include <shellapi.h> // For ShellExecuteW
 #include <codecvt> // For wstring_convert
+#include <process.h> // For _getpid
 #elif defined(__APPLE__) || defined(__linux__)
 #include <sys/wait.h> // For waitpid
+#include <sys/mman.h> // For mmap of .vmaxscene files
+#include <sys/stat.h> // For fstat
+#include <fcntl.h> // For open
+#include <signal.h> // For kill(pid, 0) in the scratch sweep
 #endif
 
 // oomer's helper utility code
@@ -60,22 +74,510 @@
 // FORWARD DECLARATIONS
 //==============================================================================
 
-dl::bella_sdk::Node add_ogt_mesh_to_scene(  dl::String bellaName, 
-                                            ogt_mesh* ogtMesh, 
-                                            dl::bella_sdk::Scene& belScene, 
-                                            dl::bella_sdk::Node& belWorld );
+/**
+ * Axis-aligned run of same material/color voxels, in voxel units
+ */
+struct VoxelBox {
+    int x, y, z;       // Minimum corner
+    int sx, sy, sz;    // Extent along each axis (>= 1)
+};
+
+/**
+ * Quad mesh with welded integer vertices, in voxel units
+ * Each quad is wound counter-clockwise when seen from outside the volume
+ */
+struct VoxelQuadMesh {
+    std::vector<std::array<int, 3>> points;
+    std::vector<std::array<uint32_t, 4>> quads;
+    size_t exposed_faces = 0;    // Unit faces before merging, for reporting
+};
+
+/**
+ * Integer voxel bounds of a model in its own space, grown while decoding
+ */
+struct VoxelBounds {
+    int min[3] = { std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::max() };
+    int max[3] = { std::numeric_limits<int>::lowest(), std::numeric_limits<int>::lowest(), std::numeric_limits<int>::lowest() };
+
+    bool empty() const { return min[0] > max[0]; }
+
+    void add(int x, int y, int z) {
+        min[0] = std::min(min[0], x); max[0] = std::max(max[0], x);
+        min[1] = std::min(min[1], y); max[1] = std::max(max[1], y);
+        min[2] = std::min(min[2], z); max[2] = std::max(max[2], z);
+    }
+};
+
+/**
+ * Per-job counters collected while building the Bella scene
+ */
+struct SceneBuildStats {
+    size_t voxel_count = 0;      // Voxels routed to the instancer path
+    size_t instance_count = 0;   // Instances actually emitted for those voxels
+    size_t instancer_count = 0;  // Instancer nodes holding those instances
+    size_t mesh_faces = 0;       // Exposed unit faces on the mesh path
+    size_t mesh_quads = 0;       // Quads actually emitted for those faces
+    size_t chunk_count = 0;      // Non-empty VoxelMax chunks decoded
+    size_t deduplicated_chunks = 0;  // Chunks replaced by an instance of an identical chunk
+    size_t material_buckets = 0; // Material/color buckets that needed a material
+    size_t material_nodes = 0;   // quickMaterial nodes actually created for them
+};
+
+/**
+ * One decoded VoxelMax chunk kept aside for content deduplication
+ */
+struct DecodedChunk {
+    oom::vmax::ChunkInfo info;
+    std::vector<oom::vmax::Voxel> voxels;   // As decoded, in model space
+    std::array<int, 3> origin;              // Minimum corner of the 32x32x32 chunk
+    std::vector<uint32_t> packed;           // Chunk-local x,y,z,material,color, sorted
+    uint64_t hash = 0;                      // FNV-1a of packed
+};
+
+/**
+ * Chunk content that occurs more than once in a model
+ * Built once as its own canonical node and instanced at every origin
+ */
+struct RepeatedChunk {
+    oom::vmax::Model model;                      // Voxels in chunk-local coordinates
+    std::vector<std::array<int, 3>> origins;     // Chunk origin of every occurrence
+    RepeatedChunk(const std::string& name) : model(name) {}
+};
+
+/**
+ * Per-element weights used by --mode auto to pick instancer vs mesh per bucket
+ * Instance and quad weights are the bytes each hands to Bella; the mesh node overhead has
+ * no buffer to size and is the weight to tune from the logged decisions.
+ * Override with --costmodel instance,quad,mesh
+ */
+struct BucketCostModel {
+    double per_instance = 64.0;     // One Mat4f instance transform
+    double per_quad = 28.0;         // One Vec4u polygon plus about one welded Pos3f point
+    double per_mesh_node = 4096.0;  // Fixed overhead of an extra mesh node and its own BVH
+};
+
+/**
+ * Exposed faces of a material/color bucket, measured without meshing it
+ */
+struct BucketSurface {
+    size_t exposed_faces = 0;    // Unit faces with no voxel of the bucket in front of them
+    size_t face_runs = 0;        // Maximal runs of those faces along one in-plane axis, estimates the quad count
+};
+
+/**
+ * Lowest quality the load governor may fall to, override with --qualityfloor res,noise,seconds,frameseconds
+ */
+struct QualityFloor {
+    int min_resolution = 320;     // Longest image side never goes below this
+    int max_target_noise = 25;    // Beauty pass noise target never goes above this
+    int min_time_budget = 20;     // A time-limited still render always gets at least this many seconds
+    int min_frame_budget = 2;     // Each time-limited orbit frame always gets at least this many seconds
+};
+
+/**
+ * Render settings chosen for one job by chooseRenderTier, recorded in /history
+ */
+struct RenderTier {
+    std::string name;             // "full", "balanced", "fast" or "rush"
+    double resolution_scale;      // Applied to the template camera resolution
+    int target_noise;             // Beauty pass noise target, 0 keeps the template's
+    int time_budget;              // Beauty pass time limit in seconds, 0 for none
+};
+
+/**
+ * Conversion switches, read once from the bot command line
+ */
+struct ConvertOptions {
+    std::string mode;                 // "" (box), "mesh", "both" or "auto"
+    bool greedy_box = false;          // Merge voxels into scaled box instances
+    bool chunk_instancers = false;    // One instancer per VoxelMax chunk instead of per bucket
+    bool dedup_chunks = false;        // Share identical chunks through one canonical chunk node
+    bool bevel = false;               // Attach oomBevel to non-liquid materials
+    bool flatten_groups = false;      // Bake group chains into instance matrices, no group xforms
+    std::string model_cache_dir;      // Decoded model cache directory, empty disables it
+    uint64_t model_cache_max_bytes = 1024ull << 20;  // Least recently used entries are evicted past this
+    bool write_intermediate = false;  // Copy each job's .vmaxscene to debug_dir
+    std::string debug_dir;            // Debug copies of each job's scene, named by job id; empty writes none
+    int preview_size = 160;           // Longest side of the quick preview render, 0 disables it
+    bool adaptive_quality = true;     // Let chooseRenderTier lower quality as the queue grows
+    QualityFloor quality_floor;       // Limits for the adaptive tiers
+    BucketCostModel cost_model;       // Weights for mode auto
+};
+
+ConvertOptions convertOptionsFromArgs(dl::Args& args);
+
+RenderTier chooseRenderTier(const ConvertOptions& options, 
+                            const std::string& requestedTier, 
+                            bool mayRaiseQuality, 
+                            int queueDepth, 
+                            const SceneBuildStats& stats, 
+                            int orbitFrames, 
+                            const dl::Vec2& baseResolution);
+
+/**
+ * One paletteN.png with its paletteN.settings.vmaxpsb, decoded once
+ */
+struct DecodedPalette {
+    std::vector<oom::vmax::RGBA> colors;            // 256 sRGB palette entries
+    std::vector<std::array<double, 4>> linear;      // Same entries as linear RGBA 0-1
+    std::array<oom::vmax::Material, 8> materials;   // Material slots from the settings plist
+};
+
+/**
+ * One VoxelMax chunk as decoded from a contentsN.vmaxb snapshot
+ */
+struct RawChunk {
+    oom::vmax::ChunkInfo info;
+    std::vector<oom::vmax::Voxel> voxels;
+};
+
+DecodedPalette makeDecodedPalette(std::vector<oom::vmax::RGBA> colors, 
+                                  const std::array<oom::vmax::Material, 8>& materials);
+DecodedPalette decodePalette(const std::string& pngPath, const std::string& settingsPath);
+
+/**
+ * Incremental SHA-256, for content keys shared between uploads of different users
+ * A 64-bit FNV key can be collided on purpose; these cannot
+ */
+class Sha256 {
+public:
+    Sha256();
+    void update(const void* data, size_t size);
+    std::array<uint8_t, 32> finish();
+
+private:
+    void compress(const uint8_t block[64]);
+
+    uint32_t state[8];
+    uint8_t buffer[64];
+    size_t buffered = 0;
+    uint64_t total_bytes = 0;
+};
+
+using ContentDigest = std::array<uint8_t, 32>;
+
+struct ContentDigestHash {
+    size_t operator()(const ContentDigest& digest) const {
+        size_t hash = 0;
+        std::memcpy(&hash, digest.data(), sizeof(hash));
+        return hash;
+    }
+};
+
+void digestFileContents(const std::string& path, Sha256& sha);
+
+// Bump whenever decoding or the cache file layout changes, old entries then miss
+constexpr uint32_t kModelCacheVersion = 2;
+
+ContentDigest modelCacheKey(const std::string& vmaxbPath, const std::string& pngPath, const std::string& settingsPath);
+ContentDigest sceneIntermediateKey(const std::vector<uint8_t>& upload);
+std::string sceneIntermediatePath(const std::string& cacheDir, const ContentDigest& key);
+bool loadCachedModel(const std::string& cacheDir, const ContentDigest& key, std::vector<RawChunk>& chunks);
+void storeCachedModel(const std::string& cacheDir, const ContentDigest& key, const std::vector<RawChunk>& chunks);
+void trimModelCache(const std::string& cacheDir, uint64_t maxBytes);
+std::vector<RawChunk> decodeVmaxbChunks(const std::string& vmaxbPath);
+
+/**
+ * Decoded palettes shared across jobs, keyed by the SHA-256 of the png and settings bytes
+ * Hashing the two small files is far cheaper than the png decode, plist parse and
+ * sRGB to linear conversion it saves. Entries are dropped wholesale past max_entries.
+ */
+class PaletteCache {
+public:
+    static constexpr size_t max_entries = 256;
+
+    std::shared_ptr<const DecodedPalette> get(const std::string& pngPath, 
+                                              const std::string& settingsPath, 
+                                              bool& decoded) {
+        Sha256 sha;
+        digestFileContents(pngPath, sha);
+        digestFileContents(settingsPath, sha);
+        ContentDigest contentHash = sha.finish();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = palettes.find(contentHash);
+            if (found != palettes.end()) {
+                decoded = false;
+                return found->second;
+            }
+        }
+
+        auto palette = std::make_shared<const DecodedPalette>(decodePalette(pngPath, settingsPath));
+        decoded = true;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (palettes.size() >= max_entries) {
+            palettes.clear();
+        }
+        palettes[contentHash] = palette;
+        return palette;
+    }
+
+private:
+    std::mutex mutex;
+    std::unordered_map<ContentDigest, std::shared_ptr<const DecodedPalette>, ContentDigestHash> palettes;
+};
+
+/**
+ * Resolved quickMaterial parameters of one material/color bucket
+ * Unused parameters stay 0 so two buckets that render identically compare equal
+ */
+struct BellaMaterialKey {
+    std::string type;             // liquid, glass, metal, dielectric, emitter, diffuse or plastic
+    float roughness = 0.0f;       // Bella 0-100
+    float transmission = 0.0f;
+    float emitter_energy = 0.0f;
+    double color[4] = {0.0, 0.0, 0.0, 0.0};  // Linear RGBA
+    bool bevel = false;
+
+    bool operator==(const BellaMaterialKey& other) const {
+        return type == other.type && 
+               roughness == other.roughness && 
+               transmission == other.transmission && 
+               emitter_energy == other.emitter_energy && 
+               std::equal(color, color + 4, other.color) && 
+               bevel == other.bevel;
+    }
+};
+
+struct BellaMaterialKeyHash {
+    size_t operator()(const BellaMaterialKey& key) const;
+};
+
+BellaMaterialKey resolveMaterialKey(int material, 
+                                    int color, 
+                                    const DecodedPalette& palette, 
+                                    bool bevel);
+
+/**
+ * One job's additions to the long-lived template scene
+ * The template (camera, environment, beauty pass, voxel prototypes, bevel, output path) is
+ * built once at startup by buildTemplateScene. Every node a job creates goes through
+ * createNode so clear() deletes exactly those, and camera orbit/resolution, render threads and
+ * the beauty pass noise target, time limit, image saving and output directory are put back too.
+ */
+class JobScene {
+public:
+    dl::bella_sdk::Scene scene;
+    dl::bella_sdk::Node root;    // Job subtree root, parented to world
+
+    JobScene(dl::bella_sdk::Scene belScene, const dl::String& rootName) : scene(belScene) {
+        baseResolution = scene.camera()["resolution"].asVec2();
+        renderResolution = baseResolution;
+        baseTargetNoise = scene.beautyPass()["targetNoise"].asInt();
+        baseTimeLimit = scene.beautyPass()["timeLimit"].asInt();
+        baseSaveImage = scene.beautyPass()["saveImage"].asInt();
+        baseThreads = scene.settings()["threads"].asInt();
+        root = createNode("xform", rootName, rootName);
+        root["steps"][0]["xform"] = dl::Mat4 {1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1};
+        root.parentTo(scene.world());
+    }
+
+    ~JobScene() {
+        clear();
+    }
+
+    dl::bella_sdk::Node createNode(const dl::String& type, const dl::String& name, const dl::String& label = "") {
+        nodes.push_back(scene.createNode(type, name, label));
+        return nodes.back();
+    }
+
+    dl::bella_sdk::Node findNode(const dl::String& name) {
+        return scene.findNode(name);
+    }
+
+    // quickMaterial nodes shared by every model in the job, see sharedMaterial()
+    std::unordered_map<BellaMaterialKey, dl::bella_sdk::Node, BellaMaterialKeyHash> materials;
+
+    // Orbits the template camera, remembering the offset so clear() can undo it
+    void orbitCamera(const dl::Vec2& offset) {
+        dl::bella_sdk::orbitCamera(scene.cameraPath(), offset);
+        cameraOrbit.x += offset.x;
+        cameraOrbit.y += offset.y;
+    }
+
+    // Scales the camera down to longestSide and accepts a much noisier image, for a preview
+    void usePreviewSettings(int longestSide) {
+        double scale = std::min(1.0, longestSide / std::max(1.0, std::max(renderResolution.x, renderResolution.y)));
+        scene.camera()["resolution"] = dl::Vec2{std::max(1.0, std::round(renderResolution.x * scale)), 
+                                                std::max(1.0, std::round(renderResolution.y * scale))};
+        scene.beautyPass()["targetNoise"] = dl::Int(kPreviewTargetNoise);
+    }
+
+    // Applies a governor tier; Bella itself stops the render once the time limit is hit
+    void applyRenderTier(const RenderTier& tier) {
+        scene.camera()["resolution"] = dl::Vec2{std::max(1.0, std::round(renderResolution.x * tier.resolution_scale)), 
+                                                std::max(1.0, std::round(renderResolution.y * tier.resolution_scale))};
+        scene.beautyPass()["targetNoise"] = dl::Int(tier.target_noise > 0 ? tier.target_noise : baseTargetNoise);
+        scene.beautyPass()["timeLimit"] = dl::Int(tier.time_budget > 0 ? tier.time_budget : baseTimeLimit);
+    }
+
+    // Job resolution with the template's aspect ratio, the base that previews and tiers scale
+    void setRenderResolution(int longestSide) {
+        double scale = longestSide / std::max(1.0, std::max(baseResolution.x, baseResolution.y));
+        renderResolution = dl::Vec2{std::max(1.0, std::round(baseResolution.x * scale)), 
+                                    std::max(1.0, std::round(baseResolution.y * scale))};
+        scene.camera()["resolution"] = renderResolution;
+    }
+
+    // Render threads of this engine, 0 for all cores; undone by restoreRenderSettings
+    void setRenderThreads(int threads) {
+        scene.settings()["threads"] = dl::Int(threads);
+    }
+
+    // Directory the beauty pass saves into, put back to the template's "." by clear()
+    void setOutputDir(const dl::String& dir) {
+        scene.beautyPass()["overridePath"].asNode()["dir"] = dir;
+    }
+
+    // Undoes usePreviewSettings, applyRenderTier and setRenderThreads
+    void restoreRenderSettings() {
+        scene.camera()["resolution"] = renderResolution;
+        scene.settings()["threads"] = dl::Int(baseThreads);
+        scene.beautyPass()["targetNoise"] = dl::Int(baseTargetNoise);
+        scene.beautyPass()["timeLimit"] = dl::Int(baseTimeLimit);
+        scene.beautyPass()["saveImage"] = dl::Int(baseSaveImage);
+    }
+
+    const dl::Vec2& resolution() const {
+        return renderResolution;
+    }
+
+    size_t nodeCount() const {
+        return nodes.size();
+    }
+
+    void reserve(size_t count) {
+        nodes.reserve(nodes.size() + count);
+    }
 
-dl::bella_sdk::Node addModelToScene(dl::Args& args, 
-                                    dl::bella_sdk::Scene& belScene, 
+    void clear() {
+        // Children were created after their parents, so delete newest first
+        for (auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+            scene.deleteNode(*it);
+        }
+        nodes.clear();
+        materials.clear();
+
+        if (cameraOrbit.x != 0.0 || cameraOrbit.y != 0.0) {
+            dl::bella_sdk::orbitCamera(scene.cameraPath(), dl::Vec2{-cameraOrbit.x, -cameraOrbit.y});
+            cameraOrbit = dl::Vec2{0.0, 0.0};
+        }
+        renderResolution = baseResolution;
+        restoreRenderSettings();
+        setOutputDir(".");
+    }
+
+private:
+    // Bella stops at this noise percentage, the template's own target is far lower
+    static constexpr int kPreviewTargetNoise = 40;
+
+    std::vector<dl::bella_sdk::Node> nodes;
+    dl::Vec2 cameraOrbit{0.0, 0.0};
+    dl::Vec2 baseResolution{0.0, 0.0};
+    dl::Vec2 renderResolution{0.0, 0.0};
+    int64_t baseTargetNoise = 0;
+    int64_t baseTimeLimit = 0;
+    int64_t baseSaveImage = 1;
+    int64_t baseThreads = 0;
+};
+
+std::vector<VoxelBox> greedyBoxesFromVoxels(const std::vector<oom::vmax::Voxel>& voxels);
+
+std::map<uint32_t, std::vector<oom::vmax::Voxel>> splitVoxelsByChunk(const std::vector<oom::vmax::Voxel>& voxels);
+
+std::optional<DecodedChunk> decodeChunkForDedup(const oom::vmax::ChunkInfo& chunkInfo, std::vector<oom::vmax::Voxel>& voxels);
+
+std::vector<RepeatedChunk> dedupModelChunks(std::vector<DecodedChunk>& chunks, 
+                                            oom::vmax::Model& model, 
+                                            SceneBuildStats& stats);
+
+void fillVoxelInstances(const std::vector<oom::vmax::Voxel>& voxels, dl::ds::Vector<dl::Mat4f>& xformsArray);
+
+void fillBoxInstances(const std::vector<VoxelBox>& boxes, dl::ds::Vector<dl::Mat4f>& xformsArray);
+
+bool preferMeshForBucket(const BucketCostModel& costModel, 
+                         const dl::String& bucketName, 
+                         size_t voxelCount, 
+                         size_t instanceCount, 
+                         const BucketSurface& surface);
+
+BucketSurface measureBucketSurface(const std::vector<oom::vmax::Voxel>& voxels);
+
+VoxelQuadMesh greedyMeshFromVoxels(const std::vector<oom::vmax::Voxel>& voxels);
+
+oom::vmax::Matrix4x4 multiplyMatrices(const oom::vmax::Matrix4x4& a, const oom::vmax::Matrix4x4& b);
+std::map<std::string, std::string> acyclicGroupParents(const std::map<std::string, oom::vmax::JsonGroupInfo>& jsonGroups);
+std::map<std::string, oom::vmax::Matrix4x4> groupWorldMatrices(const std::map<std::string, oom::vmax::JsonGroupInfo>& jsonGroups, 
+                                                               const std::map<std::string, std::string>& groupParents);
+
+template <typename ModelContentMap>
+dl::Aabb sceneBoundsFromModels(const ModelContentMap& modelVmaxbMap, 
+                               const std::map<std::string, oom::vmax::Matrix4x4>& groupWorld, 
+                               const std::map<std::string, VoxelBounds>& modelBounds);
+
+dl::bella_sdk::Node add_quad_mesh_to_scene( dl::String bellaName, 
+                                            const VoxelQuadMesh& quadMesh, 
+                                            JobScene& belScene );
+
+dl::bella_sdk::Node sharedMaterial(JobScene& belScene, 
+                                   const BellaMaterialKey& key, 
+                                   SceneBuildStats* stats);
+
+dl::bella_sdk::Node addModelToScene(const ConvertOptions& options, 
+                                    JobScene& belScene, 
                                     dl::bella_sdk::Node& belWorld, 
                                     const oom::vmax::Model& vmaxModel, 
-                                    const std::vector<oom::vmax::RGBA>& vmaxPalette, 
-                                    const std::array<oom::vmax::Material, 8>& vmaxMaterial); 
+                                    const DecodedPalette& palette, 
+                                    SceneBuildStats* stats = nullptr); 
 
 //==============================================================================
 // WORK QUEUE CLASSES
 //==============================================================================
 
+/**
+ * Render options from the upload message, e.g. "res=1024 orbit=60 fps=24 view=top"
+ * Parsed and validated against the uploader's RenderLimits once at upload, then stored
+ * as columns on the job row so nothing downstream re-reads the raw message text
+ */
+struct RenderRequest {
+    int resolution = 0;            // res=, longest image side in pixels, 0 keeps the template's
+    int noise = 0;                 // noise= or samples=, beauty pass noise target, 0 lets the tier decide
+    int orbit_frames = 0;          // orbit=, 0 renders a still
+    int fps = 30;                  // fps=, orbit playback rate
+    std::string view;              // view=, front/back/left/right/top, empty keeps the template camera
+    std::string quality = "auto";  // quality=, auto follows the queue, otherwise a tier name
+    double cost = 0.0;             // Estimated megapixel-frames, see renderRequestCost
+    bool raise_quality = false;    // quality= may beat the governor's tier; admins only, set when dequeued
+
+    // Non-default options as the user would type them
+    std::string summary() const {
+        std::string text;
+        auto add = [&text](const std::string& option) {
+            text += (text.empty() ? "" : " ") + option;
+        };
+        if (resolution > 0) add("res=" + std::to_string(resolution));
+        if (noise > 0) add("noise=" + std::to_string(noise));
+        if (orbit_frames > 0) add("orbit=" + std::to_string(orbit_frames));
+        if (orbit_frames > 0 && fps != 30) add("fps=" + std::to_string(fps));
+        if (!view.empty()) add("view=" + view);
+        if (quality != "auto") add("quality=" + quality);
+        return text;
+    }
+};
+
+/**
+ * Per-user ceilings for RenderRequest, see renderLimitsForUser
+ */
+struct RenderLimits {
+    int max_resolution;
+    int max_orbit_frames;
+    int max_fps;
+    int min_noise;
+    double max_cost;               // Megapixel-frames per job
+};
+
+RenderRequest parseRenderRequest(const std::string& message_content, std::vector<std::string>& warnings);
+
 /**
  * Structure representing a work item in the processing queue
  */
@@ -86,13 +588,169 @@ struct WorkItem {
     uint64_t channel_id;           // Discord channel ID for response
     uint64_t user_id;              // Discord user ID for mentions
     std::string username;          // Discord username for display
-    std::string message_content;   // Discord message content for orbit parsing
+    std::string message_content;   // Discord message content as uploaded
+    RenderRequest request;         // Render options parsed from message_content
     int64_t created_at;            // Unix timestamp when job was created
     int retry_count;               // Number of times this job has been retried
     
     WorkItem() : id(0), channel_id(0), user_id(0), created_at(0), retry_count(0) {}
 };
 
+/**
+ * Last image of a render as 8-bit RGBA, rows top to bottom
+ */
+struct RenderFrame {
+    std::vector<uint8_t> rgba;
+    int width = 0;
+    int height = 0;
+};
+
+/**
+ * Wakes the worker as soon as a render ends or the current job is cancelled
+ * MyEngineObserver reports stop/error/images, WorkQueue reports cancellation, and the worker
+ * sleeps on one condition variable instead of polling engine.rendering()
+ */
+class RenderSignal {
+public:
+    enum class Outcome { Finished, Failed, Cancelled };
+
+    /**
+     * Wall time of the last render split at its first progress callback
+     * setup_ms stands in for scene translation and acceleration structure builds; it is a proxy
+     * read from the callback timing, not a figure Bella reports, and sampling_ms is the rest
+     */
+    struct Timing {
+        double setup_ms = 0.0;
+        double sampling_ms = 0.0;
+    };
+
+    /**
+     * Call right before engine.start() so the previous frame's stop is not seen again
+     * With captureFrames the newest image of the render is kept for takeFrame()
+     */
+    void arm(bool captureFrames = false) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = false;
+        error.clear();
+        capture = captureFrames;
+        frame = RenderFrame{};
+        armedAt = std::chrono::steady_clock::now();
+        samplingAt = stoppedAt = std::chrono::steady_clock::time_point{};
+    }
+
+    // Called from every progress callback, only the first one of a render is kept
+    void notifySampling() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (samplingAt == std::chrono::steady_clock::time_point{}) {
+            samplingAt = std::chrono::steady_clock::now();
+        }
+    }
+
+    Timing lastTiming() {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto end = stoppedAt == std::chrono::steady_clock::time_point{} ? std::chrono::steady_clock::now() : stoppedAt;
+        auto split = samplingAt == std::chrono::steady_clock::time_point{} ? end : samplingAt;
+        return Timing{std::chrono::duration<double, std::milli>(split - armedAt).count(), 
+                      std::chrono::duration<double, std::milli>(end - split).count()};
+    }
+
+    // Called for every progressive image, only the last one before the stop survives
+    void storeFrame(const dl::bella_sdk::Image& image) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!capture) {
+            return;
+        }
+        const uint8_t* pixels = reinterpret_cast<const uint8_t*>(image.rgba8());
+        if (!pixels) {
+            return;
+        }
+        frame.width = static_cast<int>(image.width());
+        frame.height = static_cast<int>(image.height());
+        frame.rgba.assign(pixels, pixels + static_cast<size_t>(frame.width) * frame.height * 4);
+    }
+
+    // Moves the captured image out, false when the render produced none
+    bool takeFrame(RenderFrame& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (frame.rgba.empty()) {
+            return false;
+        }
+        out = std::move(frame);
+        frame = RenderFrame{};
+        return true;
+    }
+
+    void notifyStopped() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        stoppedAt = std::chrono::steady_clock::now();
+        condition.notify_all();
+    }
+
+    void notifyError(const std::string& message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = message;
+        condition.notify_all();
+    }
+
+    // Only wakes the waiter, which then asks its cancel predicate
+    void notifyCancel() {
+        std::lock_guard<std::mutex> lock(mutex);
+        condition.notify_all();
+    }
+
+    /**
+     * Blocks until the armed render stops or cancelRequested() turns true
+     * A once a second watchdog covers an engine that stops without an onStopped callback
+     */
+    Outcome wait(dl::bella_sdk::Engine& engine, const std::function<bool()>& cancelRequested) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            if (cancelRequested()) {
+                return Outcome::Cancelled;
+            }
+            if (stopped) {
+                return error.empty() ? Outcome::Finished : Outcome::Failed;
+            }
+            if (condition.wait_for(lock, std::chrono::seconds(1)) == std::cv_status::timeout && !stopped) {
+                // Never call into the engine while holding the lock its callbacks need
+                lock.unlock();
+                bool rendering = engine.rendering();
+                lock.lock();
+                if (!rendering) {
+                    stopped = true;
+                    stoppedAt = std::chrono::steady_clock::now();
+                }
+            }
+        }
+    }
+
+    std::string lastError() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return error;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopped = false;
+    std::string error;
+    bool capture = false;
+    RenderFrame frame;
+    std::chrono::steady_clock::time_point armedAt;
+    std::chrono::steady_clock::time_point samplingAt;
+    std::chrono::steady_clock::time_point stoppedAt;
+};
+
+/**
+ * Render progress of the current frame as reported by MyEngineObserver
+ */
+struct RenderProgress {
+    std::string pass;              // Bella pass name, empty before the first callback
+    double percent = 0.0;          // 0-100
+    int64_t eta_seconds = -1;      // Estimated from wall time and percent, -1 until known
+};
+
 /**
  * SQLite-backed FIFO work queue for managing .vmax.zip file processing jobs
  * Provides persistence across system crashes and sequential processing
@@ -105,6 +763,7 @@ private:
     std::atomic<bool> shutdown_requested{false};
     std::atomic<bool> cancel_current_job{false};
     std::atomic<int64_t> current_job_id{0};
+    RenderSignal* render_signal = nullptr;
     
 public:
     WorkQueue() : db(nullptr) {}
@@ -137,7 +796,18 @@ public:
                 bella_start_time INTEGER DEFAULT 0,
                 bella_end_time INTEGER DEFAULT 0,
                 username TEXT DEFAULT '',
-                message_content TEXT DEFAULT ''
+                message_content TEXT DEFAULT '',
+                progress_percent REAL DEFAULT 0,
+                progress_pass TEXT DEFAULT '',
+                progress_eta INTEGER DEFAULT -1,
+                quality_tier TEXT DEFAULT '',
+                render_resolution INTEGER DEFAULT 0,
+                render_noise INTEGER DEFAULT 0,
+                render_orbit INTEGER DEFAULT 0,
+                render_fps INTEGER DEFAULT 30,
+                render_view TEXT DEFAULT '',
+                render_quality TEXT DEFAULT 'auto',
+                render_cost REAL DEFAULT -1
             );
             
             CREATE INDEX IF NOT EXISTS idx_status_created 
@@ -152,6 +822,21 @@ public:
             return false;
         }
         
+        // Databases created before a column existed get it added here
+        if (!ensureColumn("progress_percent", "REAL DEFAULT 0") || 
+            !ensureColumn("progress_pass", "TEXT DEFAULT ''") || 
+            !ensureColumn("progress_eta", "INTEGER DEFAULT -1") || 
+            !ensureColumn("quality_tier", "TEXT DEFAULT ''") || 
+            !ensureColumn("render_resolution", "INTEGER DEFAULT 0") || 
+            !ensureColumn("render_noise", "INTEGER DEFAULT 0") || 
+            !ensureColumn("render_orbit", "INTEGER DEFAULT 0") || 
+            !ensureColumn("render_fps", "INTEGER DEFAULT 30") || 
+            !ensureColumn("render_view", "TEXT DEFAULT ''") || 
+            !ensureColumn("render_quality", "TEXT DEFAULT 'auto'") || 
+            !ensureColumn("render_cost", "REAL DEFAULT -1")) {
+            return false;
+        }
+        
         std::cout << "✅ Work queue database initialized: " << db_path << std::endl;
         
         // Clean up old completed jobs (older than 24 hours)
@@ -185,13 +870,50 @@ public:
         return true;
     }
     
-    bool enqueue(const WorkItem& item) {
+    /**
+     * Adds a column to work_queue unless PRAGMA table_info already lists it
+     * Caller holds queue_mutex
+     */
+    bool ensureColumn(const char* column, const char* declaration) {
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, "PRAGMA table_info(work_queue);", -1, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "❌ Failed to read work queue schema: " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+        bool found = false;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char* name = (const char*)sqlite3_column_text(stmt, 1);
+            if (name && strcmp(name, column) == 0) {
+                found = true;
+                break;
+            }
+        }
+        sqlite3_finalize(stmt);
+        if (found) {
+            return true;
+        }
+
+        std::string alter_sql = std::string("ALTER TABLE work_queue ADD COLUMN ") + column + " " + declaration + ";";
+        char* error_msg = nullptr;
+        if (sqlite3_exec(db, alter_sql.c_str(), nullptr, nullptr, &error_msg) != SQLITE_OK) {
+            std::cerr << "❌ Failed to add column " << column << ": " << error_msg << std::endl;
+            sqlite3_free(error_msg);
+            return false;
+        }
+        std::cout << "🔧 Added work queue column " << column << std::endl;
+        return true;
+    }
+    
+    // job_id, when given, receives the new row's id
+    // on_inserted runs with the new id while the queue is still locked, before any worker can dequeue the row
+    bool enqueue(const WorkItem& item, int64_t* job_id = nullptr, const std::function<void(int64_t)>& on_inserted = nullptr) {
         std::lock_guard<std::mutex> lock(queue_mutex);
         
         const char* insert_sql = R"(
             INSERT INTO work_queue 
-            (attachment_url, original_filename, channel_id, user_id, username, message_content, created_at, retry_count)
-            VALUES (?, ?, ?, ?, ?, ?, ?, ?);
+            (attachment_url, original_filename, channel_id, user_id, username, message_content, created_at, retry_count,
+             render_resolution, render_noise, render_orbit, render_fps, render_view, render_quality, render_cost)
+            VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);
         )";
         
         sqlite3_stmt* stmt;
@@ -209,6 +931,13 @@ public:
         sqlite3_bind_text(stmt, 6, item.message_content.c_str(), -1, SQLITE_STATIC);
         sqlite3_bind_int64(stmt, 7, item.created_at);
         sqlite3_bind_int(stmt, 8, item.retry_count);
+        sqlite3_bind_int(stmt, 9, item.request.resolution);
+        sqlite3_bind_int(stmt, 10, item.request.noise);
+        sqlite3_bind_int(stmt, 11, item.request.orbit_frames);
+        sqlite3_bind_int(stmt, 12, item.request.fps);
+        sqlite3_bind_text(stmt, 13, item.request.view.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 14, item.request.quality.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_double(stmt, 15, item.request.cost);
         
         rc = sqlite3_step(stmt);
         sqlite3_finalize(stmt);
@@ -218,7 +947,14 @@ public:
             return false;
         }
         
-        std::cout << "📥 Enqueued job: " << item.original_filename << " (ID: " << sqlite3_last_insert_rowid(db) << ")" << std::endl;
+        int64_t inserted_id = sqlite3_last_insert_rowid(db);
+        if (job_id) {
+            *job_id = inserted_id;
+        }
+        if (on_inserted) {
+            on_inserted(inserted_id);
+        }
+        std::cout << "📥 Enqueued job: " << item.original_filename << " (ID: " << inserted_id << ")" << std::endl;
         
         queue_condition.notify_one();
         return true;
@@ -229,7 +965,8 @@ public:
         
         while (!shutdown_requested) {
             const char* select_sql = R"(
-                SELECT id, attachment_url, original_filename, channel_id, user_id, username, message_content, created_at, retry_count
+                SELECT id, attachment_url, original_filename, channel_id, user_id, username, message_content, created_at, retry_count,
+                       render_resolution, render_noise, render_orbit, render_fps, render_view, render_quality, render_cost
                 FROM work_queue 
                 WHERE status = 'pending'
                 ORDER BY created_at ASC
@@ -254,6 +991,21 @@ public:
                 item.message_content = (const char*)sqlite3_column_text(stmt, 6);
                 item.created_at = sqlite3_column_int64(stmt, 7);
                 item.retry_count = sqlite3_column_int(stmt, 8);
+                item.request = RenderRequest{};
+                item.request.resolution = sqlite3_column_int(stmt, 9);
+                item.request.noise = sqlite3_column_int(stmt, 10);
+                item.request.orbit_frames = sqlite3_column_int(stmt, 11);
+                item.request.fps = sqlite3_column_int(stmt, 12);
+                const unsigned char* view = sqlite3_column_text(stmt, 13);
+                const unsigned char* quality = sqlite3_column_text(stmt, 14);
+                item.request.view = view ? (const char*)view : "";
+                item.request.quality = quality ? (const char*)quality : "auto";
+                item.request.cost = sqlite3_column_double(stmt, 15);
+                if (item.request.cost < 0.0) {
+                    // Queued before options had columns, parse the message like the upload handler
+                    std::vector<std::string> warnings;
+                    item.request = parseRenderRequest(item.message_content, warnings);
+                }
                 
                 sqlite3_finalize(stmt);
                 markProcessing(item.id);
@@ -371,12 +1123,43 @@ public:
         return true;
     }
     
-    std::vector<std::tuple<std::string, std::string, int64_t, int64_t, int64_t>> getHistory(int limit = 10) {
+    /**
+     * Jobs still waiting behind the current one, read by the quality governor
+     */
+    int pendingCount() {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM work_queue WHERE status = 'pending';", -1, &stmt, nullptr) != SQLITE_OK) {
+            return 0;
+        }
+        int count = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+        sqlite3_finalize(stmt);
+        return count;
+    }
+    
+    bool setQualityTier(int64_t item_id, const std::string& tier) {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        
+        sqlite3_stmt* stmt;
+        int rc = sqlite3_prepare_v2(db, "UPDATE work_queue SET quality_tier = ? WHERE id = ?;", -1, &stmt, nullptr);
+        if (rc != SQLITE_OK) {
+            std::cerr << "❌ Failed to prepare quality tier update: " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+        sqlite3_bind_text(stmt, 1, tier.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 2, item_id);
+        rc = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        return rc == SQLITE_DONE;
+    }
+    
+    std::vector<std::tuple<std::string, std::string, int64_t, int64_t, int64_t, std::string>> getHistory(int limit = 10) {
         std::lock_guard<std::mutex> lock(queue_mutex);
-        std::vector<std::tuple<std::string, std::string, int64_t, int64_t, int64_t>> result;
+        std::vector<std::tuple<std::string, std::string, int64_t, int64_t, int64_t, std::string>> result;
         
         const char* history_sql = R"(
-            SELECT original_filename, username, bella_start_time, bella_end_time, created_at
+            SELECT original_filename, username, bella_start_time, bella_end_time, created_at, quality_tier
             FROM work_queue 
             WHERE status = 'completed' AND bella_start_time > 0 AND bella_end_time > 0
             ORDER BY bella_end_time DESC
@@ -398,7 +1181,9 @@ public:
             int64_t bella_start_time = sqlite3_column_int64(stmt, 2);
             int64_t bella_end_time = sqlite3_column_int64(stmt, 3);
             int64_t created_at = sqlite3_column_int64(stmt, 4);
-            result.emplace_back(filename, username, bella_start_time, bella_end_time, created_at);
+            const unsigned char* quality_tier = sqlite3_column_text(stmt, 5);
+            result.emplace_back(filename, username, bella_start_time, bella_end_time, created_at, 
+                                quality_tier ? (const char*)quality_tier : "");
         }
         
         sqlite3_finalize(stmt);
@@ -429,6 +1214,9 @@ public:
             sqlite3_finalize(stmt);
             
             cancel_current_job = true;
+            if (render_signal) {
+                render_signal->notifyCancel();
+            }
             std::cout << "🛑 Admin requested cancellation of job " << job_id << ": " << filename << std::endl;
             return filename;
         } else {
@@ -465,8 +1253,40 @@ public:
     void setCurrentJobId(int64_t job_id) {
         current_job_id = job_id;
     }
-    
-    uint64_t getCurrentJobOwnerId() {
+
+    // 0 once markCurrentJobCancelled has removed the job
+    int64_t getCurrentJobId() const {
+        return current_job_id.load();
+    }
+
+    /**
+     * Stores the current job's render progress in its row
+     */
+    void updateCurrentJobProgress(const RenderProgress& progress) {
+        int64_t job_id = current_job_id.load();
+        if (job_id <= 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        
+        const char* update_sql = "UPDATE work_queue SET progress_percent = ?, progress_pass = ?, progress_eta = ? WHERE id = ?;";
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, update_sql, -1, &stmt, nullptr) == SQLITE_OK) {
+            sqlite3_bind_double(stmt, 1, progress.percent);
+            sqlite3_bind_text(stmt, 2, progress.pass.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 3, progress.eta_seconds);
+            sqlite3_bind_int64(stmt, 4, job_id);
+            sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+        }
+    }
+
+    // Cancellation also wakes a worker waiting on this render signal
+    void setRenderSignal(RenderSignal* signal) {
+        render_signal = signal;
+    }
+    
+    uint64_t getCurrentJobOwnerId() {
         std::lock_guard<std::mutex> lock(queue_mutex);
         
         const char* select_sql = R"(
@@ -498,12 +1318,13 @@ public:
         queue_condition.notify_all();
     }
     
-    std::vector<std::tuple<std::string, std::string, bool, int64_t>> getQueueDisplay() {
+    // filename, username, processing, bella_start_time, progress percent, pass, eta seconds
+    std::vector<std::tuple<std::string, std::string, bool, int64_t, double, std::string, int64_t>> getQueueDisplay() {
         std::lock_guard<std::mutex> lock(queue_mutex);
-        std::vector<std::tuple<std::string, std::string, bool, int64_t>> result;
+        std::vector<std::tuple<std::string, std::string, bool, int64_t, double, std::string, int64_t>> result;
         
         const char* processing_sql = R"(
-            SELECT original_filename, username, bella_start_time
+            SELECT original_filename, username, bella_start_time, progress_percent, progress_pass, progress_eta
             FROM work_queue 
             WHERE status = 'processing'
             ORDER BY created_at ASC;
@@ -516,7 +1337,11 @@ public:
                 std::string filename = (const char*)sqlite3_column_text(stmt, 0);
                 std::string username = (const char*)sqlite3_column_text(stmt, 1);
                 int64_t bella_start_time = sqlite3_column_int64(stmt, 2);
-                result.emplace_back(filename, username, true, bella_start_time);
+                double progress_percent = sqlite3_column_double(stmt, 3);
+                const char* progress_pass = (const char*)sqlite3_column_text(stmt, 4);
+                int64_t progress_eta = sqlite3_column_int64(stmt, 5);
+                result.emplace_back(filename, username, true, bella_start_time, 
+                                    progress_percent, progress_pass ? progress_pass : "", progress_eta);
             }
             sqlite3_finalize(stmt);
         }
@@ -533,7 +1358,7 @@ public:
             while (sqlite3_step(stmt) == SQLITE_ROW) {
                 std::string filename = (const char*)sqlite3_column_text(stmt, 0);
                 std::string username = (const char*)sqlite3_column_text(stmt, 1);
-                result.emplace_back(filename, username, false, 0);
+                result.emplace_back(filename, username, false, 0, 0.0, "", -1);
             }
             sqlite3_finalize(stmt);
         }
@@ -559,6 +1384,222 @@ private:
     }
 };
 
+/**
+ * One Discord status message per job, edited in place as the job moves through
+ * queued → downloading → converting → rendering x% → encoding → uploading → done
+ * Callers only replace the latest text; a single flush thread sends it with at most one
+ * request in flight per message, one edit per message every kMessageInterval and one
+ * request of any kind every kRequestSpacing, so however often the engine reports
+ * progress the number of Discord requests stays bounded
+ */
+class JobStatusBoard {
+public:
+    explicit JobStatusBoard(dpp::cluster* bot) : bot(bot) {
+        flusher = std::thread([this]() { run(); });
+    }
+
+    ~JobStatusBoard() {
+        stop();
+    }
+
+    /**
+     * Starts tracking a job, as a reply to reply_to when non-zero
+     * A job that is already tracked keeps its message and stage. The upload handler
+     * tracks from inside WorkQueue::enqueue, so its entry always precedes the worker's
+     */
+    void track(int64_t job_id, dpp::snowflake channel_id, dpp::snowflake reply_to, const std::string& stage) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (entries.count(job_id)) {
+            return;
+        }
+        Entry& entry = entries[job_id];
+        entry.channel_id = channel_id;
+        entry.reply_to = reply_to;
+        entry.stage = stage;
+        condition.notify_one();
+    }
+
+    // Replaces the stage line and drops the percentage of the previous stage
+    void setStage(int64_t job_id, const std::string& stage) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = entries.find(job_id);
+        if (found == entries.end() || found->second.finished) {
+            return;
+        }
+        found->second.stage = stage;
+        found->second.percent = -1.0;
+        condition.notify_one();
+    }
+
+    // Job whose status receives setActiveProgress, 0 when the worker is idle
+    void setActive(int64_t job_id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        active_job_id = job_id;
+    }
+
+    // Called from every engine progress callback, only stores the number
+    void setActiveProgress(double percent) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = entries.find(active_job_id);
+        if (found != entries.end() && !found->second.finished) {
+            found->second.percent = percent;
+        }
+    }
+
+    // Last text of the job, sent like any other update, after which the job is forgotten
+    void finish(int64_t job_id, const std::string& text) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = entries.find(job_id);
+        if (found == entries.end()) {
+            return;
+        }
+        found->second.stage = text;
+        found->second.percent = -1.0;
+        found->second.finished = true;
+        condition.notify_one();
+    }
+
+    /**
+     * Stops the flush thread, first giving final texts and outstanding requests a few
+     * seconds so no callback runs after the board is gone
+     */
+    void stop() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (stopping) {
+                return;
+            }
+            condition.wait_for(lock, std::chrono::seconds(5), [this]() {
+                for (const auto& [job_id, entry] : entries) {
+                    if (entry.in_flight || (entry.finished && entry.sent != entry.text())) {
+                        return false;
+                    }
+                }
+                return true;
+            });
+            stopping = true;
+            condition.notify_all();
+        }
+        if (flusher.joinable()) {
+            flusher.join();
+        }
+    }
+
+private:
+    static constexpr std::chrono::milliseconds kMessageInterval{3000};
+    static constexpr std::chrono::milliseconds kRequestSpacing{1000};
+    static constexpr int kMaxFailures = 3;
+
+    struct Entry {
+        dpp::snowflake channel_id = 0;
+        dpp::snowflake reply_to = 0;
+        dpp::snowflake message_id = 0;  // 0 until Discord confirms the first post
+        std::string stage;
+        double percent = -1.0;          // Appended to the stage when >= 0
+        std::string sent;               // Text of the last request Discord accepted or is handling
+        bool in_flight = false;
+        bool finished = false;
+        int failures = 0;
+        std::chrono::steady_clock::time_point last_request;
+
+        std::string text() const {
+            if (percent < 0.0) {
+                return stage;
+            }
+            return stage + " — " + std::to_string(static_cast<int>(percent)) + "%";
+        }
+    };
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::chrono::steady_clock::time_point last_request;
+        while (!stopping) {
+            condition.wait_for(lock, std::chrono::milliseconds(250));
+            if (stopping) {
+                break;
+            }
+            auto now = std::chrono::steady_clock::now();
+
+            // Forget jobs whose final text is out, or whose message keeps failing
+            for (auto it = entries.begin(); it != entries.end();) {
+                const Entry& entry = it->second;
+                bool delivered = entry.finished && !entry.in_flight && entry.message_id != 0 && entry.sent == entry.text();
+                bool abandoned = !entry.in_flight && entry.failures >= kMaxFailures;
+                it = (delivered || abandoned) ? entries.erase(it) : std::next(it);
+            }
+            if (now - last_request < kRequestSpacing) {
+                continue;
+            }
+
+            // Oldest due message goes first so one busy job cannot starve the others
+            Entry* next = nullptr;
+            int64_t next_job_id = 0;
+            for (auto& [job_id, entry] : entries) {
+                if (entry.in_flight || entry.sent == entry.text() || now - entry.last_request < kMessageInterval) {
+                    continue;
+                }
+                if (!next || entry.last_request < next->last_request) {
+                    next = &entry;
+                    next_job_id = job_id;
+                }
+            }
+            if (!next) {
+                continue;
+            }
+
+            next->in_flight = true;
+            next->sent = next->text();
+            next->last_request = now;
+            last_request = now;
+            dpp::message msg(next->channel_id, next->sent);
+            bool create = next->message_id == 0;
+            if (create) {
+                if (next->reply_to != 0) {
+                    msg.set_reference(next->reply_to);
+                }
+            } else {
+                msg.id = next->message_id;
+            }
+
+            // DPP only queues the request, the callback runs later on its own thread
+            lock.unlock();
+            auto done = [this, next_job_id, create](const dpp::confirmation_callback_t& callback) {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto found = entries.find(next_job_id);
+                if (found != entries.end()) {
+                    Entry& entry = found->second;
+                    entry.in_flight = false;
+                    if (callback.is_error()) {
+                        std::cout << "⚠️ Status message for job " << next_job_id << " failed: " << callback.get_error().message << std::endl;
+                        entry.sent.clear();
+                        entry.failures++;
+                    } else {
+                        entry.failures = 0;
+                        if (create) {
+                            entry.message_id = callback.get<dpp::message>().id;
+                        }
+                    }
+                }
+                condition.notify_all();
+            };
+            if (create) {
+                bot->message_create(msg, done);
+            } else {
+                bot->message_edit(msg, done);
+            }
+            lock.lock();
+        }
+    }
+
+    dpp::cluster* bot;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::map<int64_t, Entry> entries;
+    int64_t active_job_id = 0;
+    bool stopping = false;
+    std::thread flusher;
+};
+
 //==============================================================================
 // UTILITY FUNCTIONS
 //==============================================================================
@@ -587,882 +1628,2778 @@ std::string getHiddenInput(const std::string& prompt) {
 }
 
 /**
- * Function to parse orbit from Discord message content
+ * Bella node id for a VoxelMax UUID: dashes become underscores, prefixed with "_"
  */
-int parseOrbit(const std::string& message_content) {
-    std::string content_lower = message_content;
-    std::transform(content_lower.begin(), content_lower.end(), content_lower.begin(), ::tolower);
-    
-    size_t pos = content_lower.find("orbit=");
-    if (pos == std::string::npos) {
-        return 0;
-    }
-    
-    size_t start = pos + 6; // Length of "orbit="
-    if (start >= message_content.length()) {
-        return 0;
-    }
-    
-    size_t end = message_content.find_first_of(" \t\n\r", start);
-    if (end == std::string::npos) {
-        end = message_content.length();
+dl::String belNodeId(const std::string& vmaxId) {
+    std::string nodeId = "_" + vmaxId;
+    std::replace(nodeId.begin(), nodeId.end(), '-', '_');
+    return dl::String(nodeId.c_str());
+}
+
+/**
+ * Milliseconds elapsed since start, for timing logs
+ */
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Scratch root of this bot process: vmax_scratch/<pid>
+ * Several bot processes may share a working directory and one queue database, so each
+ * one only ever creates, deletes or sweeps directories under its own root.
+ */
+std::string scratchRoot() {
+#ifdef _WIN32
+    static const std::string root = "vmax_scratch/" + std::to_string(_getpid());
+#else
+    static const std::string root = "vmax_scratch/" + std::to_string(getpid());
+#endif
+    return root;
+}
+
+/**
+ * Scratch directory holding everything one job writes: the upload, its extracted .vmax,
+ * the preview and the final jpg/mp4. Nothing is shared between jobs, so the worker can
+ * delete it in one go and concurrent jobs never see each other's files.
+ */
+std::string jobScratchDir(int64_t item_id) {
+    return scratchRoot() + "/job" + std::to_string(item_id);
+}
+
+/**
+ * Debug copy of a job's file outside its scratch directory: <debugDir>/job<ID><suffix>
+ * Named by job id only, so concurrent jobs with the same upload name never collide
+ */
+std::string debugDumpPath(const std::string& debugDir, int64_t item_id, const std::string& suffix) {
+    std::error_code ec;
+    std::filesystem::create_directories(debugDir, ec);
+    return (std::filesystem::path(debugDir) / ("job" + std::to_string(item_id) + suffix)).string();
+}
+
+/**
+ * Upload file name without its .vmax.zip extension, used to name the files sent back
+ */
+std::string uploadBaseName(const std::string& filename) {
+    const std::string extension = ".vmax.zip";
+    if (filename.length() >= extension.length() && 
+        filename.compare(filename.length() - extension.length(), extension.length(), extension) == 0) {
+        return filename.substr(0, filename.length() - extension.length());
     }
-    
-    std::string frames_str = message_content.substr(start, end - start);
-    
-    try {
-        int frames = std::stoi(frames_str);
-        
-        if (frames <= 0 || frames > 300) {
-            std::cout << "⚠️ Invalid orbit frame count: " << frames << " (must be 1-300)" << std::endl;
-            return 0;
+    return filename;
+}
+
+void removeJobScratch(int64_t item_id) {
+    std::error_code ec;
+    std::filesystem::remove_all(jobScratchDir(item_id), ec);
+}
+
+/**
+ * Deletes scratch roots left behind by a crash, called before the worker starts
+ * Only roots whose process is gone are removed (plus a stale one reusing our pid), so a
+ * second bot sharing the working directory keeps its live jobs. Pending jobs simply
+ * rebuild theirs.
+ */
+void sweepJobScratch() {
+    size_t removed = 0;
+    std::error_code ec;
+    std::string ownRoot = std::filesystem::path(scratchRoot()).filename().string();
+    for (const auto& entry : std::filesystem::directory_iterator("vmax_scratch", ec)) {
+        std::string name = entry.path().filename().string();
+        bool stale = name == ownRoot;
+#ifndef _WIN32
+        char* end = nullptr;
+        long pid = std::strtol(name.c_str(), &end, 10);
+        if (!stale && pid > 0 && *end == '\0') {
+            stale = kill(static_cast<pid_t>(pid), 0) != 0 && errno == ESRCH;
         }
-        
-        std::cout << "✅ Parsed orbit frames: " << frames << std::endl;
-        return frames;
-        
-    } catch (const std::exception& e) {
-        std::cout << "⚠️ Failed to parse orbit frame count: " << e.what() << std::endl;
-        return 0;
+#endif
+        if (stale) {
+            std::filesystem::remove_all(entry.path(), ec);
+            removed++;
+        }
+    }
+    if (removed > 0) {
+        std::cout << "🧹 Removed " << removed << " stale scratch roots" << std::endl;
     }
 }
 
-//==============================================================================
-// VMAX PROCESSING FUNCTIONS
-//==============================================================================
-
 /**
- * Function to process .vmax.zip file and convert to rendered output
+ * Splits [0, count) into contiguous chunks and runs fn(begin, end) on each in parallel
+ * Small ranges run inline on the calling thread
  */
-std::string processVmaxFile(dl::bella_sdk::Engine& engine, const std::vector<uint8_t>& vmax_data, const std::string& filename, const std::string& message_content, WorkQueue* work_queue, int64_t item_id) {
-    std::cout << "🔄 Processing .vmax.zip file (" << vmax_data.size() << " bytes)..." << std::endl;
-    
-    // Fix locale issues for Bella Engine
-    try {
-        std::locale::global(std::locale("C"));
-        std::cout << "✅ Set locale to 'C' for Bella Engine compatibility" << std::endl;
-    } catch (const std::exception& e) {
-        std::cout << "⚠️ Could not set locale: " << e.what() << std::endl;
+template <typename Fn>
+void parallelChunks(size_t count, Fn&& fn, size_t minChunk = 65536) {
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunks = std::min(workers, (count + minChunk - 1) / minChunk);
+    if (chunks <= 1) {
+        fn(size_t(0), count);
+        return;
     }
-    
-    // Save .vmax.zip data to temporary file with unique name based on job ID
-    std::string temp_vmax_filename = "temp_vmax_file_job" + std::to_string(item_id) + ".vmax.zip";
-    std::ofstream temp_vmax_file(temp_vmax_filename, std::ios::binary);
-    temp_vmax_file.write(reinterpret_cast<const char*>(vmax_data.data()), vmax_data.size());
-    temp_vmax_file.close();
-    
-    std::cout << "💾 Saved .vmax.zip to working file: " << temp_vmax_filename << std::endl;
-    
-    // Extract the zip file to unique work directories based on job ID
-    std::string work_dir = "voxel_max_workdir_job" + std::to_string(item_id);
-    std::string temp_extract_dir = "temp_vmax_extract_job" + std::to_string(item_id);
-    
-    // First extract to temp directory
-    std::string unzip_cmd = "unzip -o -d " + temp_extract_dir + " " + temp_vmax_filename;
-    std::cout << "📦 Extracting: " << unzip_cmd << std::endl;
-    
-    int unzip_result = system(unzip_cmd.c_str());
-    if (unzip_result != 0) {
-        std::cout << "❌ Failed to extract .vmax.zip file" << std::endl;
-        std::remove(temp_vmax_filename.c_str());
-        return "";
+
+    size_t step = (count + chunks - 1) / chunks;
+    std::vector<std::thread> threads;
+    threads.reserve(chunks - 1);
+    for (size_t c = 1; c < chunks; c++) {
+        size_t begin = c * step;
+        size_t end = std::min(count, begin + step);
+        threads.emplace_back([&fn, begin, end]() { fn(begin, end); });
     }
-    
-    // Find the .vmax directory and move its contents to work directory
-    std::filesystem::remove_all(work_dir); // Clean any existing work directory
-    std::filesystem::create_directories(work_dir);
-    
-    // Look for .vmax directory in extracted files
-    bool found_vmax_dir = false;
-    for (const auto& entry : std::filesystem::directory_iterator(temp_extract_dir)) {
-        if (entry.is_directory() && entry.path().extension() == ".vmax") {
-            std::cout << "📁 Found .vmax directory: " << entry.path().filename() << std::endl;
-            
-            // Copy contents to work directory
-            for (const auto& file : std::filesystem::recursive_directory_iterator(entry.path())) {
-                if (file.is_regular_file()) {
-                    auto rel_path = std::filesystem::relative(file.path(), entry.path());
-                    auto dest_path = work_dir + "/" + rel_path.string();
-                    
-                    // Create parent directories if needed
-                    std::filesystem::create_directories(std::filesystem::path(dest_path).parent_path());
-                    std::filesystem::copy_file(file.path(), dest_path, std::filesystem::copy_options::overwrite_existing);
-                }
-            }
-            found_vmax_dir = true;
-            break;
-        }
+    fn(size_t(0), std::min(count, step));
+    for (auto& thread : threads) {
+        thread.join();
     }
-    
-    // Clean up temp extraction directory
-    std::filesystem::remove_all(temp_extract_dir);
-    
-    if (!found_vmax_dir) {
-        std::cout << "❌ No .vmax directory found in extracted files" << std::endl;
-        std::remove(temp_vmax_filename.c_str());
-        std::filesystem::remove_all(work_dir);
-        return "";
+}
+
+/**
+ * Long-running ffmpeg fed raw RGBA frames on stdin, so orbit encoding overlaps rendering
+ * push() queues the frame and returns while fewer than kMaxQueuedFrames wait, otherwise it
+ * blocks until the writer thread has handed one to the pipe, so a slow ffmpeg holds back the
+ * renderers instead of letting frames pile up in memory. ffmpeg is started with the size of
+ * the first frame.
+ */
+class FrameEncoder {
+public:
+    static constexpr size_t kMaxQueuedFrames = 3;
+
+    FrameEncoder(const std::string& outputPath, int fps) : output(outputPath), fps(fps) {}
+
+    ~FrameEncoder() {
+        finish();
     }
-    
-    try {
-        // Get Bella scene (already initialized)
-        auto belScene = engine.scene();
-        
-        // CRITICAL FIX: Clear all removable nodes from previous jobs to avoid scene contamination
-        std::cout << "🧹 Clearing previous scene nodes for job " << item_id << "..." << std::endl;
-        dl::UInt clearedCount = belScene.clearNodes(false); // Clear all nodes (not just unreferenced)
-        std::cout << "✅ Cleared " << clearedCount << " nodes from previous jobs" << std::endl;
-        
-        // Initialize basic scene elements
-        oom::bella::defaultScene2025(belScene);
-        auto [belWorld, belMeshVoxel, belLiqVoxel, belVoxel, belEmitterBlockXform] = oom::bella::defaultSceneVoxel(belScene);
-        
-        // Extract base filename for output
-        std::string base_filename = filename;
-        if (base_filename.length() >= 9 && base_filename.substr(base_filename.length() - 9) == ".vmax.zip") {
-            base_filename = base_filename.substr(0, base_filename.length() - 9);
-        }
-        
-        std::cout << "📷 Setting output filename to: " << base_filename << ".jpg" << std::endl;
-        
-        belScene.beautyPass()["outputExt"] = ".jpg";
-        belScene.beautyPass()["outputName"] = base_filename.c_str();
-        auto imgOutputPath = belScene.createNode("outputImagePath", "vmaxOutputPath");
-        imgOutputPath["ext"] = ".jpg";
-        imgOutputPath["dir"] = ".";
-        belScene.beautyPass()["saveImage"] = dl::Int(1);  // ENABLE image saving!
-        belScene.beautyPass()["overridePath"] = imgOutputPath;
 
-        // Create dummy args for the vmax processing
-        dl::Args args(0, nullptr);
-        
-        // Process the VMAX scene
-        dl::String vmaxDirName = work_dir.c_str();
-        
-        std::cout << "🎯 Processing VMAX scene from: " << vmaxDirName.buf() << std::endl;
-        
-        // Parse scene.json
-        oom::vmax::JsonSceneParser vmaxSceneParser;
-        std::string scene_json_path = work_dir + "/scene.json";
-        
-        if (!std::filesystem::exists(scene_json_path)) {
-            std::cout << "❌ scene.json not found in extracted files" << std::endl;
-            return "";
+    // False once ffmpeg could not be started or a frame did not match the first one's size
+    bool push(std::vector<uint8_t>&& rgba, int frameWidth, int frameHeight) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (failed || closed) {
+            return false;
         }
-        
-        vmaxSceneParser.parseScene(scene_json_path.c_str());
-        
-        std::map<std::string, oom::vmax::JsonGroupInfo> jsonGroups = vmaxSceneParser.getGroups();
-        std::map<dl::String, dl::bella_sdk::Node> belGroupNodes;
-        std::map<dl::String, dl::bella_sdk::Node> belCanonicalNodes;
-
-        // Create Bella nodes for groups
-        for (const auto& [groupName, groupInfo] : jsonGroups) { 
-            dl::String belGroupUUID = dl::String(groupName.c_str());
-            belGroupUUID = belGroupUUID.replace("-", "_");
-            belGroupUUID = "_" + belGroupUUID;
-            belGroupNodes[belGroupUUID] = belScene.createNode("xform", belGroupUUID, belGroupUUID);
-
-            oom::vmax::Matrix4x4 objectMat4 = oom::vmax::combineTransforms(groupInfo.rotation[0], 
-                                              groupInfo.rotation[1], 
-                                              groupInfo.rotation[2], 
-                                              groupInfo.rotation[3],
-                                              groupInfo.position[0], 
-                                              groupInfo.position[1], 
-                                              groupInfo.position[2], 
-                                              groupInfo.scale[0], 
-                                              groupInfo.scale[1], 
-                                              groupInfo.scale[2]);
-
-            belGroupNodes[belGroupUUID]["steps"][0]["xform"] = dl::Mat4({
-                objectMat4.m[0][0], objectMat4.m[0][1], objectMat4.m[0][2], objectMat4.m[0][3],
-                objectMat4.m[1][0], objectMat4.m[1][1], objectMat4.m[1][2], objectMat4.m[1][3],
-                objectMat4.m[2][0], objectMat4.m[2][1], objectMat4.m[2][2], objectMat4.m[2][3],
-                objectMat4.m[3][0], objectMat4.m[3][1], objectMat4.m[3][2], objectMat4.m[3][3]
-                });
+        if (!pipe) {
+            width = frameWidth;
+            height = frameHeight;
+            std::string command = "ffmpeg -y -loglevel error -f rawvideo -pix_fmt rgba -s " + 
+                                  std::to_string(width) + "x" + std::to_string(height) + 
+                                  " -framerate " + std::to_string(fps) + 
+                                  " -i - -c:v libx264 -pix_fmt yuv420p " + output;
+            std::cout << "🎬 Starting encoder: " << command << std::endl;
+#ifdef _WIN32
+            pipe = _popen(command.c_str(), "wb");
+#else
+            pipe = popen(command.c_str(), "w");
+#endif
+            if (!pipe) {
+                std::cout << "❌ Could not start ffmpeg" << std::endl;
+                failed = true;
+                return false;
+            }
+            writer = std::thread([this]() { run(); });
+        }
+        if (frameWidth != width || frameHeight != height || rgba.size() < static_cast<size_t>(width) * height * 4) {
+            std::cout << "❌ Frame " << frameWidth << "x" << frameHeight << " does not match encoder size " 
+                      << width << "x" << height << std::endl;
+            failed = true;
+            return false;
+        }
+        space.wait(lock, [this]() { return frames.size() < kMaxQueuedFrames || failed || closed; });
+        if (failed || closed) {
+            return false;
         }
+        frames.push_back(std::move(rgba));
+        condition.notify_one();
+        return true;
+    }
 
-        // Parent the groups
-        for (const auto& [groupName, groupInfo] : jsonGroups) { 
-            dl::String belGroupUUID = dl::String(groupName.c_str());
-            belGroupUUID = belGroupUUID.replace("-", "_");
-            belGroupUUID = "_" + belGroupUUID;
-            if (groupInfo.parentId == "") {
-                belGroupNodes[belGroupUUID].parentTo(belWorld);
-            } else {
-                dl::String belPPPGroupUUID = dl::String(groupInfo.parentId.c_str());
-                belPPPGroupUUID = belPPPGroupUUID.replace("-", "_");
-                belPPPGroupUUID = "_" + belPPPGroupUUID;
-                dl::bella_sdk::Node myParentGroup = belGroupNodes[belPPPGroupUUID];
-                belGroupNodes[belGroupUUID].parentTo(myParentGroup);
+    /**
+     * Waits for queued frames to be written, closes ffmpeg's stdin and waits for it to exit
+     * True when every frame was written and ffmpeg exited cleanly
+     */
+    bool finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (closed) {
+                return result;
+            }
+            closed = true;
+            condition.notify_one();
+            space.notify_all();
+        }
+        if (writer.joinable()) {
+            writer.join();
+        }
+        if (pipe) {
+#ifdef _WIN32
+            int status = _pclose(pipe);
+#else
+            int status = pclose(pipe);
+#endif
+            pipe = nullptr;
+            result = !failed && status == 0;
+            if (status != 0) {
+                std::cout << "❌ FFmpeg exited with status " << status << std::endl;
             }
         }
+        return result;
+    }
 
-        // Process models
-        auto modelVmaxbMap = vmaxSceneParser.getModelContentVMaxbMap(); 
-        std::vector<oom::vmax::Model> allModels;
-        std::vector<std::vector<oom::vmax::RGBA>> vmaxPalettes;
-        std::vector<std::array<oom::vmax::Material, 8>> vmaxMaterials;
-        
-        std::cout << "🎨 Processing " << modelVmaxbMap.size() << " unique models..." << std::endl;
-        
-        // Process each unique model
-        for (const auto& [vmaxContentName, vmaxModelList] : modelVmaxbMap) { 
-            // Check for cancellation
-            if (work_queue && work_queue->shouldCancelCurrentJob()) {
-                std::cout << "🛑 Cancelling vmax processing for job " << item_id << std::endl;
-                work_queue->markCurrentJobCancelled();
-                return "";
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            condition.wait(lock, [this]() { return !frames.empty() || closed; });
+            if (frames.empty()) {
+                return;
             }
-            
-            std::cout << "📦 Processing model: " << vmaxContentName << std::endl;
-            oom::vmax::Model currentVmaxModel(vmaxContentName);
-            const auto& jsonModelInfo = vmaxModelList.front();
-
-            // Get file names
-            dl::String materialName = vmaxDirName + "/" + jsonModelInfo.paletteFile.c_str();
-            materialName = materialName.replace(".png", ".settings.vmaxpsb");
-
-            // Get this model's colors from the paletteN.png 
-            dl::String pngName = vmaxDirName + "/" + jsonModelInfo.paletteFile.c_str();
-            vmaxPalettes.push_back(oom::vmax::read256x1PaletteFromPNG(pngName.buf()));
-            if (vmaxPalettes.empty()) { 
-                throw std::runtime_error(std::string("Failed to read palette from: ") + pngName.buf()); 
-            }
-
-            // Read contentsN.vmaxb plist file, lzfse compressed
-            dl::String modelFileName = vmaxDirName + "/" + jsonModelInfo.dataFile.c_str();
-            plist_t plist_model_root = oom::vmax::readPlist(modelFileName.buf(), true);
-
-            plist_t plist_snapshots_array = plist_dict_get_item(plist_model_root, "snapshots");
-            uint32_t snapshots_array_size = plist_array_get_size(plist_snapshots_array);
-
-            // Process snapshots
-            for (uint32_t i = 0; i < snapshots_array_size; i++) {
-                plist_t plist_snapshot = plist_array_get_item(plist_snapshots_array, i);
-                plist_t plist_chunk = oom::vmax::getNestedPlistNode(plist_snapshot, {"s", "id", "c"});
-                plist_t plist_datastream = oom::vmax::getNestedPlistNode(plist_snapshot, {"s", "ds"});
-                uint64_t chunkID;
-                plist_get_uint_val(plist_chunk, &chunkID);
-                oom::vmax::ChunkInfo chunkInfo = oom::vmax::vmaxChunkInfo(plist_snapshot);
-                std::vector<oom::vmax::Voxel> xvoxels = oom::vmax::vmaxVoxelInfo(plist_datastream, chunkInfo.id, chunkInfo.mortoncode);
-
-                for (const auto& voxel : xvoxels) {
-                    currentVmaxModel.addVoxel(voxel.x, voxel.y, voxel.z, voxel.material, voxel.palette, chunkInfo.id, chunkInfo.mortoncode);
-                }
+            std::vector<uint8_t> frame = std::move(frames.front());
+            frames.pop_front();
+            space.notify_one();
+            lock.unlock();
+            size_t bytes = static_cast<size_t>(width) * height * 4;
+            bool written = std::fwrite(frame.data(), 1, bytes, pipe) == bytes;
+            lock.lock();
+            if (!written) {
+                std::cout << "❌ Encoder pipe closed early" << std::endl;
+                failed = true;
+                frames.clear();
+                space.notify_all();
             }
-            allModels.push_back(currentVmaxModel);
-            
-            // Parse the materials stored in paletteN.settings.vmaxpsb    
-            plist_t plist_material = oom::vmax::readPlist(materialName.buf(), false);
-            std::array<oom::vmax::Material, 8> currentMaterials = oom::vmax::getMaterials(plist_material);
-            vmaxMaterials.push_back(currentMaterials);
         }
+    }
 
-        std::cout << "🏗️ Creating canonical models..." << std::endl;
-        
-        // Create canonical models
-        int modelIndex = 0;
-        for (const auto& eachModel : allModels) {
-            // Check for cancellation
-            if (work_queue && work_queue->shouldCancelCurrentJob()) {
-                std::cout << "🛑 Cancelling vmax processing for job " << item_id << std::endl;
-                work_queue->markCurrentJobCancelled();
-                return "";
-            }
-            
-            std::cout << "🎨 Model " << modelIndex << ": " << eachModel.vmaxbFileName << " (voxels: " << eachModel.getTotalVoxelCount() << ")" << std::endl;
-            
-            dl::bella_sdk::Node belModel = addModelToScene(args, belScene, belWorld, eachModel, vmaxPalettes[modelIndex], vmaxMaterials[modelIndex]);
-            
-            dl::String lllmodelName = dl::String(eachModel.vmaxbFileName.c_str());
-            dl::String lllcanonicalName = lllmodelName.replace(".vmaxb", "");
-            belCanonicalNodes[lllcanonicalName.buf()] = belModel;
-            modelIndex++;
-        }
+    std::string output;
+    int fps;
+    int width = 0;
+    int height = 0;
+    FILE* pipe = nullptr;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable condition;    // Frames queued or closed, wakes the writer
+    std::condition_variable space;        // Queue below kMaxQueuedFrames or encoder done, wakes push()
+    std::deque<std::vector<uint8_t>> frames;
+    bool closed = false;
+    bool failed = false;
+    bool result = false;
+};
 
-        std::cout << "🎪 Creating instances..." << std::endl;
-        
-        // Create instances
-        for (const auto& [vmaxContentName, vmaxModelList] : modelVmaxbMap) { 
-            oom::vmax::Model currentVmaxModel(vmaxContentName);
-            for(const auto& jsonModelInfo : vmaxModelList) {
-                // Check for cancellation
-                if (work_queue && work_queue->shouldCancelCurrentJob()) {
-                    std::cout << "🛑 Cancelling vmax processing for job " << item_id << std::endl;
-                    work_queue->markCurrentJobCancelled();
-                    return "";
-                }
-                
-                std::vector<double> position = jsonModelInfo.position;
-                std::vector<double> rotation = jsonModelInfo.rotation;
-                std::vector<double> scale = jsonModelInfo.scale;
-                auto jsonParentId = jsonModelInfo.parentId;
-                auto belParentId = dl::String(jsonParentId.c_str());
-                dl::String belParentGroupUUID = belParentId.replace("-", "_");
-                belParentGroupUUID = "_" + belParentGroupUUID;
-
-                auto belObjectId = dl::String(jsonModelInfo.id.c_str());
-                belObjectId = belObjectId.replace("-", "_");
-                belObjectId = "_" + belObjectId;
-
-                dl::String getCanonicalName = dl::String(jsonModelInfo.dataFile.c_str());
-                dl::String canonicalName = getCanonicalName.replace(".vmaxb", "");
-                auto belCanonicalNode = belCanonicalNodes[canonicalName.buf()];
-                auto foofoo = belScene.findNode(canonicalName);
+/**
+ * Extra Bella engine for orbit frames, created at startup by --orbitengines
+ * It loads a snapshot of the job scene and renders whole frames. Its observer only feeds
+ * the engine's own RenderSignal; progress comes from the main engine alone.
+ */
+struct OrbitEngine : public dl::bella_sdk::EngineObserver {
+    dl::bella_sdk::Engine engine;
+    RenderSignal signal;
 
-                oom::vmax::Matrix4x4 objectMat4 = oom::vmax::combineTransforms(rotation[0], rotation[1], rotation[2], rotation[3],
-                                                                 position[0], position[1], position[2], 
-                                                                 scale[0], scale[1], scale[2]);
+    OrbitEngine() {
+        engine.scene().loadDefs();
+        engine.subscribe(this);
+    }
 
-                auto belNodeObjectInstance = belScene.createNode("xform", belObjectId, belObjectId);
-                belNodeObjectInstance["steps"][0]["xform"] = dl::Mat4({
-                    objectMat4.m[0][0], objectMat4.m[0][1], objectMat4.m[0][2], objectMat4.m[0][3],
-                    objectMat4.m[1][0], objectMat4.m[1][1], objectMat4.m[1][2], objectMat4.m[1][3],
-                    objectMat4.m[2][0], objectMat4.m[2][1], objectMat4.m[2][2], objectMat4.m[2][3],
-                    objectMat4.m[3][0], objectMat4.m[3][1], objectMat4.m[3][2], objectMat4.m[3][3]
-                    });
+    ~OrbitEngine() {
+        engine.unsubscribe(this);
+    }
 
-                if (jsonParentId == "") {
-                    belNodeObjectInstance.parentTo(belScene.world());
-                } else {
-                    dl::bella_sdk::Node myParentGroup = belGroupNodes[belParentGroupUUID];
-                    belNodeObjectInstance.parentTo(myParentGroup);
-                }
-                foofoo.parentTo(belNodeObjectInstance);
-            }
-        }
+    // Replaces whatever an earlier job left with the snapshot at path
+    // The scene is cleared first, so nothing depends on whether read() merges or replaces
+    bool loadSnapshot(const std::string& path) {
+        engine.scene().clear();
+        return engine.scene().read(path.c_str());
+    }
 
-        // Position camera to view the entire scene
-        std::cout << "📷 Setting up camera positioning..." << std::endl;
-        
-        // Calculate bounding box of all voxels in the scene
-        std::cout << "📐 Calculating scene bounding box from voxels..." << std::endl;
-        
-        double min_x = std::numeric_limits<double>::max();
-        double min_y = std::numeric_limits<double>::max();
-        double min_z = std::numeric_limits<double>::max();
-        double max_x = std::numeric_limits<double>::lowest();
-        double max_y = std::numeric_limits<double>::lowest();
-        double max_z = std::numeric_limits<double>::lowest();
-        
-        int total_voxel_count = 0;
-        
-        // Iterate through all models to find voxel extents
-        for (const auto& model : allModels) {
-            // Get all material/color combinations for this model
-            const auto& usedMaterialsAndColors = model.getUsedMaterialsAndColors();
-            
-            for (const auto& [material, colorIDs] : usedMaterialsAndColors) {
-                for (int colorID : colorIDs) {
-                    // Get all voxels for this material/color combination
-                    const std::vector<oom::vmax::Voxel>& voxels = model.getVoxels(material, colorID);
-                    
-                    for (const auto& voxel : voxels) {
-                        // Update bounding box with voxel position
-                        min_x = std::min(min_x, static_cast<double>(voxel.x));
-                        min_y = std::min(min_y, static_cast<double>(voxel.y));
-                        min_z = std::min(min_z, static_cast<double>(voxel.z));
-                        max_x = std::max(max_x, static_cast<double>(voxel.x));
-                        max_y = std::max(max_y, static_cast<double>(voxel.y));
-                        max_z = std::max(max_z, static_cast<double>(voxel.z));
-                        total_voxel_count++;
-                    }
-                }
-            }
-        }
+    // Drops the snapshot once the orbit is done, so an idle engine does not hold the last job's scene
+    void releaseSnapshot() {
+        engine.scene().clear();
+    }
 
-        // Zoom extents bbox and radius calculation
-        // Initialize bbox to "inverted infinity" so first point will always expand it
-        dl::Aabb sceneBbox;
-        sceneBbox.min = dl::Pos3::make(std::numeric_limits<double>::max(), 
-                                       std::numeric_limits<double>::max(), 
-                                       std::numeric_limits<double>::max());
-        sceneBbox.max = dl::Pos3::make(std::numeric_limits<double>::lowest(), 
-                                       std::numeric_limits<double>::lowest(), 
-                                       std::numeric_limits<double>::lowest());
-        int voxelCount = 0;
+    void onProgress(dl::String pass, dl::bella_sdk::Progress progress) override {
+        signal.notifySampling();
+    }
 
-        //  
-        auto worldPaths = belScene.world().paths(); 
-        for ( auto eachPath : worldPaths ) // World Tree
-        {
-            auto eachLeaf = eachPath.leaf();  
-            if ( !eachLeaf.isTypeOf( "instancer" ) )
-                continue;            
-            voxelCount++;
-
-            auto instances = eachLeaf["steps"][0]["instances"].asBufferT<dl::Mat4f>(); // just need count
-            for (dl::UInt i = 0; i < instances.count; ++i) {
-                // Since we are dealing with 1x1x1 voxels
-                // approximate by using center of voxel instance instead of 8 corners
-                // for bbox calculation
-                auto instanceXform = eachPath.transform(0.0,i); // use InstanceIdx for world space xform
-                auto instancePos = dl::math::translation(instanceXform); // Extract translation directly
-                
-                // No branch - always expand (faster for large instance counts)
-                if (instancePos.x < sceneBbox.min.x) sceneBbox.min.x = instancePos.x;
-                if (instancePos.y < sceneBbox.min.y) sceneBbox.min.y = instancePos.y;
-                if (instancePos.z < sceneBbox.min.z) sceneBbox.min.z = instancePos.z;
-                if (instancePos.x > sceneBbox.max.x) sceneBbox.max.x = instancePos.x;
-                if (instancePos.y > sceneBbox.max.y) sceneBbox.max.y = instancePos.y;
-                if (instancePos.z > sceneBbox.max.z) sceneBbox.max.z = instancePos.z;
-            }
-        }
+    void onImage(dl::String pass, dl::bella_sdk::Image image) override {
+        signal.storeFrame(image);
+    }
 
-        auto center = ( sceneBbox.min.v3 + sceneBbox.max.v3 ) * 0.5;
-        auto radius =dl::math::norm( sceneBbox.max - sceneBbox.min ) * 0.5;
-        dl::bella_sdk::zoomExtents(belScene.cameraPath(), dl::Vec3{center.x, center.y, center.z}, radius);       
-        std::cout << "✅ Camera positioning complete" << std::endl;
+    void onError(dl::String pass, dl::String msg) override {
+        dl::logError("Orbit engine: %s [%s]", msg.buf(), pass.buf());
+        signal.notifyError(msg.buf());
+    }
 
-        auto belCamera = belScene.camera();
+    void onStopped(dl::String pass) override {
+        signal.notifyStopped();
+    }
+};
 
-        // Orbit camera slightly for better view
-        auto offset1 = dl::Vec2 {-45, 0.0};
-        dl::bella_sdk::orbitCamera(engine.scene().cameraPath(), offset1);
-        
-        // Save .bsz file for debugging
-        std::string bsz_filename = base_filename + "_debug.bsz";
-        std::cout << "💾 Saving Bella scene file for debugging: " << bsz_filename << std::endl;
-        try {
-            belScene.write(bsz_filename.c_str());
-            std::cout << "✅ Bella scene saved: " << bsz_filename << std::endl;
-        } catch (const std::exception& e) {
-            std::cout << "⚠️ Failed to save Bella scene file: " << e.what() << std::endl;
-        }
+/**
+ * Discord users who may cancel any job and get the wider render limits
+ */
+bool isAdminUser(uint64_t user_id) {
+    static const std::vector<uint64_t> ADMIN_USER_IDS = {
+        780541438022254624ULL  // harvey
+    };
+    return std::find(ADMIN_USER_IDS.begin(), ADMIN_USER_IDS.end(), user_id) != ADMIN_USER_IDS.end();
+}
 
-        // Mark bella start time
-        if (work_queue) {
-            work_queue->markBellaStarted(item_id);
+/**
+ * Parses key=value render options out of a Discord message
+ * Words that are not options are left alone, so options can sit inside normal chat text.
+ * Values that cannot be used are reported in warnings and left at their defaults.
+ */
+RenderRequest parseRenderRequest(const std::string& message_content, std::vector<std::string>& warnings) {
+    RenderRequest request;
+    std::istringstream words(message_content);
+    std::string word;
+    while (words >> word) {
+        size_t equals = word.find('=');
+        if (equals == std::string::npos || equals == 0) {
+            continue;
         }
+        std::string key = word.substr(0, equals);
+        std::string value = word.substr(equals + 1);
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        std::transform(value.begin(), value.end(), value.begin(), ::tolower);
 
-        // Check for orbit animation
-        int orbit_frames = parseOrbit(message_content);
-        
-        if (orbit_frames > 0) {
-            // Orbit camera animation rendering
-            std::cout << "🎨 Starting orbit animation with " << orbit_frames << " frames..." << std::endl;
-            
-            belCamera["resolution"] = dl::Vec2{320, 320};
-            
-            for (int i = 0; i < orbit_frames; i++) {
-                // Check for cancellation before each frame
-                if (work_queue && work_queue->shouldCancelCurrentJob()) {
-                    std::cout << "🛑 Cancelling orbit render for job " << item_id << " at frame " << i << std::endl;
-                    work_queue->markCurrentJobCancelled();
-                    return "";
-                }
-                
-                std::cout << "📹 Rendering frame " << (i + 1) << "/" << orbit_frames << std::endl;
-                
-                auto offset = dl::Vec2{i*0.05, 0.0};
-                dl::bella_sdk::orbitCamera(engine.scene().cameraPath(), offset);
-                auto belBeautyPass = belScene.beautyPass();
-                belBeautyPass["outputName"] = dl::String::format("frame_%04d", i);
-                
-                engine.start();
-                while(engine.rendering()) { 
-                    if (work_queue && work_queue->shouldCancelCurrentJob()) {
-                        std::cout << "🛑 Cancelling orbit render during frame " << (i + 1) << std::endl;
-                        engine.stop();
-                        work_queue->markCurrentJobCancelled();
-                        return "";
-                    }
-                    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-                }
-                
-                std::cout << "✅ Frame " << (i + 1) << " completed" << std::endl;
+        auto number = [&](int low, int high, int& out) {
+            char* end = nullptr;
+            long parsed = std::strtol(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0' || parsed < low || parsed > high) {
+                warnings.push_back("`" + key + "=" + value + "` ignored (must be " + std::to_string(low) + "-" + std::to_string(high) + ")");
+                return;
             }
-            
-            std::cout << "🎬 All frames rendered, creating MP4 with ffmpeg..." << std::endl;
-            
-            // Create MP4 using ffmpeg
-            std::string output_mp4 = base_filename + "_orbit.mp4";
-            std::string ffmpegCmd = "ffmpeg -y -loglevel error -framerate 30 -i frame_%04d.jpg -c:v libx264 -pix_fmt yuv420p " + output_mp4;
-            
-            std::cout << "Executing FFmpeg command: " << ffmpegCmd << std::endl;
-            int result = system(ffmpegCmd.c_str());
-            
-            if (result == 0) {
-                std::cout << "✅ MP4 conversion successful: " << output_mp4 << std::endl;
-                
-                // Clean up individual frame files
-                for (int i = 0; i < orbit_frames; i++) {
-                    char frame_file[32];
-                    snprintf(frame_file, sizeof(frame_file), "frame_%04d.jpg", i);
-                    std::remove(frame_file);
-                }
-                std::cout << "🧹 Cleaned up individual frame files" << std::endl;
-                
-                // Clean up temporary files
-                std::filesystem::remove_all(work_dir);
-                std::remove(temp_vmax_filename.c_str());
-                
-                return output_mp4;
-            } else {
-                std::cout << "❌ FFmpeg conversion failed with error code: " << result << std::endl;
-                return "";
+            out = static_cast<int>(parsed);
+        };
+
+        if (key == "res") {
+            number(64, 8192, request.resolution);
+        } else if (key == "noise") {
+            number(1, 100, request.noise);
+        } else if (key == "samples") {
+            // Monte Carlo noise falls with the square root of the sample count
+            int samples = 0;
+            number(1, 65536, samples);
+            if (samples > 0) {
+                request.noise = std::max(1, static_cast<int>(std::lround(100.0 / std::sqrt(static_cast<double>(samples)))));
             }
-            
-        } else {
-            // Single frame rendering
-            std::cout << "🎨 Starting single frame bella render..." << std::endl;
-            
-            engine.start();
-            
-            // Wait for rendering to complete, checking for cancellation
-            bool was_cancelled = false;
-            while(engine.rendering()) { 
-                if (work_queue && work_queue->shouldCancelCurrentJob()) {
-                    std::cout << "🛑 Cancelling bella render for job " << item_id << std::endl;
-                    engine.stop();
-                    was_cancelled = true;
-                    break;
-                }
-                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        } else if (key == "orbit") {
+            number(1, 1000, request.orbit_frames);
+        } else if (key == "fps") {
+            number(1, 120, request.fps);
+        } else if (key == "view") {
+            if (value == "front" || value == "back" || value == "left" || value == "right" || value == "top") {
+                request.view = value;
+            } else {
+                warnings.push_back("`view=" + value + "` ignored (front, back, left, right or top)");
             }
-            
-            if (was_cancelled) {
-                std::cout << "🛑 Bella render cancelled successfully" << std::endl;
-                work_queue->markCurrentJobCancelled();
-                return "";
+        } else if (key == "quality") {
+            if (value == "auto" || value == "full" || value == "balanced" || value == "fast" || value == "rush") {
+                request.quality = value;
+            } else {
+                warnings.push_back("`quality=" + value + "` ignored (auto, full, balanced, fast or rush)");
             }
-            
-            std::cout << "✅ Single frame render completed!" << std::endl;
-            
-            // Clean up temporary files
-            std::filesystem::remove_all(work_dir);
-            std::remove(temp_vmax_filename.c_str());
-            
-            return base_filename + ".jpg";
         }
-        
-    } catch (const std::exception& e) {
-        std::cerr << "❌ Error processing .vmax.zip file: " << e.what() << std::endl;
-        
-        // Clean up temporary files
-        std::filesystem::remove_all(work_dir);
-        std::remove(temp_vmax_filename.c_str());
-        
-        return "";
     }
+    return request;
 }
 
 /**
- * Worker thread function that processes the work queue sequentially
+ * Limits a request may use, wider for admins
  */
-void workerThread(dpp::cluster* bot, WorkQueue* work_queue, dl::bella_sdk::Engine* engine) {
-    std::cout << "🔧 Worker thread started" << std::endl;
-    
-    WorkItem item;
-    while (work_queue->dequeue(item)) {
-        std::cout << "\n--- PROCESSING VMAX FILE (Job " << item.id << ") ---" << std::endl;
-        std::cout << "Downloading: " << item.original_filename << std::endl;
-        std::cout << "From URL: " << item.attachment_url << std::endl;
-        
-        // Download the .vmax.zip file using DPP's HTTP client
-        std::cout << "🌐 Starting .vmax.zip file download..." << std::endl;
-        
-        std::mutex download_mutex;
-        std::condition_variable download_cv;
-        bool download_complete = false;
-        bool download_success = false;
-        std::string download_data;
-        
-        bot->request(item.attachment_url, dpp::m_get, [&](const dpp::http_request_completion_t& response) {
-            std::lock_guard<std::mutex> lock(download_mutex);
-            
-            if (response.status == 200) {
-                std::cout << "✅ Downloaded .vmax.zip file (" << response.body.size() << " bytes)" << std::endl;
-                
-                // DEBUG: Add simple checksum to verify file content
-                std::hash<std::string> hasher;
-                size_t content_hash = hasher(response.body);
-                std::cout << "🔍 File content hash: " << std::hex << content_hash << std::dec << std::endl;
-                
-                download_data = response.body;
-                download_success = true;
-            } else {
-                std::cout << "❌ Failed to download .vmax.zip file. Status: " << response.status << std::endl;
-                download_success = false;
-            }
-            
-            download_complete = true;
-            download_cv.notify_one();
-        });
-        
-        // Wait for download to complete
-        {
-            std::unique_lock<std::mutex> lock(download_mutex);
-            download_cv.wait(lock, [&]{ return download_complete; });
+RenderLimits renderLimitsForUser(uint64_t user_id) {
+    if (isAdminUser(user_id)) {
+        return RenderLimits{4096, 1000, 120, 1, 2000.0};
+    }
+    return RenderLimits{1920, 300, 60, 3, 60.0};
+}
+
+/**
+ * Estimated render cost in megapixel-frames, scaled by how much cleaner than a 10% noise
+ * target the image has to get; templateSide stands in for an unset res=
+ */
+double renderRequestCost(const RenderRequest& request, int templateSide) {
+    double side = request.resolution > 0 ? request.resolution : request.orbit_frames > 0 ? 320 : templateSide;
+    double frames = std::max(1, request.orbit_frames);
+    double noiseFactor = request.noise > 0 ? 10.0 / request.noise : 1.0;
+    return side * side / 1.0e6 * frames * noiseFactor;
+}
+
+/**
+ * Clamps a request to the user's limits, shrinking resolution and then frame count until
+ * its cost fits, and stores the final cost. Every change is reported in warnings.
+ */
+void applyRenderLimits(RenderRequest& request, const RenderLimits& limits, int templateSide, std::vector<std::string>& warnings) {
+    if (request.resolution > limits.max_resolution) {
+        warnings.push_back("res lowered to " + std::to_string(limits.max_resolution));
+        request.resolution = limits.max_resolution;
+    }
+    if (request.orbit_frames > limits.max_orbit_frames) {
+        warnings.push_back("orbit lowered to " + std::to_string(limits.max_orbit_frames) + " frames");
+        request.orbit_frames = limits.max_orbit_frames;
+    }
+    if (request.fps > limits.max_fps) {
+        warnings.push_back("fps lowered to " + std::to_string(limits.max_fps));
+        request.fps = limits.max_fps;
+    }
+    if (request.noise > 0 && request.noise < limits.min_noise) {
+        warnings.push_back("noise raised to " + std::to_string(limits.min_noise));
+        request.noise = limits.min_noise;
+    }
+
+    double cost = renderRequestCost(request, templateSide);
+    if (cost > limits.max_cost) {
+        int side = request.resolution > 0 ? request.resolution : request.orbit_frames > 0 ? 320 : templateSide;
+        int fitted = std::max(64, static_cast<int>(side * std::sqrt(limits.max_cost / cost)));
+        if (fitted < side) {
+            request.resolution = fitted;
+            warnings.push_back("res lowered to " + std::to_string(fitted) + " to fit your render budget");
         }
-        
-        if (download_success) {
-            work_queue->setCurrentJobId(item.id);
-            
-            std::vector<uint8_t> original_data(download_data.begin(), download_data.end());
-            
-            if (work_queue->shouldCancelCurrentJob()) {
-                std::cout << "🛑 Job " << item.id << " cancelled before processing" << std::endl;
-                work_queue->markCurrentJobCancelled();
-                continue;
-            }
-            
-            // Process the .vmax.zip file
-            std::string output_filename = processVmaxFile(*engine, original_data, item.original_filename, item.message_content, work_queue, item.id);
-            
-            if (work_queue->shouldCancelCurrentJob() || output_filename.empty()) {
-                std::cout << "🛑 Job " << item.id << " was cancelled or failed during processing" << std::endl;
-                if (work_queue->shouldCancelCurrentJob()) {
-                    work_queue->markCurrentJobCancelled();
-                }
-                continue;
-            }
-            
-            // Read and send the output file
-            std::vector<uint8_t> file_data;
-            dpp::message msg(item.channel_id, "");
-            
-            std::ifstream output_file(output_filename, std::ios::binary);
-            
-            if (output_file.is_open()) {
-                output_file.seekg(0, std::ios::end);
-                size_t file_size = output_file.tellg();
-                output_file.seekg(0, std::ios::beg);
-                
-                file_data.resize(file_size);
-                output_file.read(reinterpret_cast<char*>(file_data.data()), file_size);
-                output_file.close();
-                
-                std::cout << "📁 Read output file: " << output_filename << " (" << file_data.size() << " bytes)" << std::endl;
-                
-                bool is_mp4 = (output_filename.length() >= 4 && output_filename.substr(output_filename.length() - 4) == ".mp4");
-                
-                if (is_mp4) {
-                    msg.content = "🎬 Here's your VoxelMax orbit animation! <@" + std::to_string(item.user_id) + ">";
-                } else {
-                    msg.content = "🎨 Here's your rendered VoxelMax image! <@" + std::to_string(item.user_id) + ">";
-                }
-                msg.add_file(output_filename, std::string(file_data.begin(), file_data.end()));
-            } else {
-                std::cout << "❌ Could not read output file: " << output_filename << std::endl;
-                msg.content = "❌ Rendering completed but could not read output file. <@" + std::to_string(item.user_id) + ">";
-            }
-            
-            // Send the message
-            std::mutex send_mutex;
-            std::condition_variable send_cv;
-            bool send_complete = false;
-            bool send_success = false;
-            
-            bot->message_create(msg, [&](const dpp::confirmation_callback_t& callback) {
-                std::lock_guard<std::mutex> lock(send_mutex);
-                
-                if (callback.is_error()) {
-                    std::cout << "❌ Failed to send message: " << callback.get_error().message << std::endl;
-                    send_success = false;
-                } else {
-                    if (file_data.empty()) {
-                        std::cout << "✅ Successfully sent error message for " << item.original_filename << std::endl;
-                    } else {
-                        std::cout << "✅ Successfully sent " << output_filename << "!" << std::endl;
-                    }
-                    send_success = true;
-                }
-                
-                send_complete = true;
-                send_cv.notify_one();
-            });
-            
-            // Wait for send to complete
-            {
-                std::unique_lock<std::mutex> lock(send_mutex);
-                send_cv.wait(lock, [&]{ return send_complete; });
-            }
-            
-            if (send_success && !file_data.empty()) {
-                work_queue->markCompleted(item.id);
-            } else {
-                work_queue->markFailed(item.id);
-            }
-            
-        } else {
-            // Download failed
-            bot->message_create(dpp::message(item.channel_id, "❌ Failed to download .vmax.zip file for processing."));
-            work_queue->markFailed(item.id);
+        cost = renderRequestCost(request, templateSide);
+        if (cost > limits.max_cost && request.orbit_frames > 1) {
+            int frames = std::max(1, static_cast<int>(request.orbit_frames * limits.max_cost / cost));
+            request.orbit_frames = frames;
+            warnings.push_back("orbit lowered to " + std::to_string(frames) + " frames to fit your render budget");
+            cost = renderRequestCost(request, templateSide);
         }
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
     }
-    
-    std::cout << "🔧 Worker thread shutting down" << std::endl;
+    request.cost = cost;
 }
 
-struct MyEngineObserver : public dl::bella_sdk::EngineObserver
-{
-public:
-    // Called when a rendering pass starts
-    void onStarted(dl::String pass) override
-    {
-        dl::logInfo("Started pass %s", pass.buf());
-    }
+/**
+ * Orbit offset from the template camera for a view= name, in degrees like every orbitCamera call
+ */
+dl::Vec2 viewOrbitOffset(const std::string& view) {
+    if (view == "left") return dl::Vec2{90.0, 0.0};
+    if (view == "back") return dl::Vec2{180.0, 0.0};
+    if (view == "right") return dl::Vec2{-90.0, 0.0};
+    if (view == "top") return dl::Vec2{0.0, 72.0};
+    return dl::Vec2{0.0, 0.0};
+}
 
-    // Called to update the current status of rendering
-    void onStatus(dl::String pass, dl::String status) override
-    {
-        dl::logInfo("%s [%s]", status.buf(), pass.buf());
-    }
+//==============================================================================
+// SCENE INTERMEDIATE FORMAT (.vmaxscene)
+//==============================================================================
+//
+// Versioned little endian hand-off between decoding and scene building: palettes with
+// their material slots, models with AABBs and their voxels per VoxelMax chunk, and the
+// scene.json group/instance hierarchy. Every job decodes into one, then builds its Bella
+// models from the mapped file; with --modelcache it is kept under the upload's SHA-256, so
+// a retry or re-upload of the same bundle skips decoding altogether.
+// A fixed header lists every section's offset; sections are 8 byte aligned arrays of the
+// POD records below, so a reader can mmap the file and index them in place.
 
-    // Called to update rendering progress (percentage, time remaining, etc)
-    void onProgress(dl::String pass, dl::bella_sdk::Progress progress) override
-    {
-        dl::logInfo("%s [%s]", progress.toString().buf(), pass.buf());
-    }
+constexpr uint32_t kSceneIntermediateVersion = 2;
 
-    void onImage(dl::String pass, dl::bella_sdk::Image image) override
-    {
-        dl::logInfo("We got an image %d x %d.", (int)image.width(), (int)image.height());
-    }  
+enum VmxsSectionType : uint32_t {
+    VmxsPalettes = 0,     // VmxsPalette[count]
+    VmxsModels,           // VmxsModel[count]
+    VmxsChunks,           // VmxsChunk[count]
+    VmxsVoxels,           // VmxsVoxel[count]
+    VmxsGroups,           // VmxsNode[count], parent indexes into groups
+    VmxsInstances,        // VmxsNode[count], parent indexes into groups, model into models
+    VmxsStrings,          // char[count], NUL terminated names referenced by offset
+    VmxsSectionCount
+};
 
-    // Called when an error occurs during rendering
-    void onError(dl::String pass, dl::String msg) override
-    {
-        dl::logError("%s [%s]", msg.buf(), pass.buf());
-    }
+struct VmxsSection {
+    uint32_t type;
+    uint32_t count;
+    uint64_t offset;
+    uint64_t size;
+};
 
-    // Called when a rendering pass completes
-    void onStopped(dl::String pass) override
-    {
-        dl::logInfo("Stopped %s", pass.buf());
-    }
+struct VmxsHeader {
+    char magic[4];        // "VMXS"
+    uint32_t version;
+    uint32_t section_count;
+    uint32_t reserved;
+    VmxsSection sections[VmxsSectionCount];
+};
 
-    // Returns the current progress as a string
-    std::string getProgress() const {
-        std::string* currentProgress = progressPtr.load();
-        if (currentProgress) {
-            return *currentProgress;
-        } else {
-            return "";
-        }
-    }
+struct VmxsMaterial {
+    float transmission;
+    float roughness;
+    float metalness;
+    float emission;
+};
+
+struct VmxsPalette {
+    uint8_t rgba[256][4];
+    VmxsMaterial materials[8];
+};
+
+struct VmxsModel {
+    uint32_t name;          // String offset, the scene.json dataFile
+    uint32_t palette;
+    int32_t min[3];         // Voxel AABB, inclusive; min > max when empty
+    int32_t max[3];
+    uint32_t first_chunk;
+    uint32_t chunk_count;
+};
+
+struct VmxsChunk {
+    uint32_t id;            // VoxelMax snapshot chunk id
+    uint32_t mortoncode;
+    uint64_t first_voxel;
+    uint64_t voxel_count;
+};
+
+struct VmxsVoxel {
+    uint16_t x;             // Model space, writeSceneIntermediate fails rather than truncate
+    uint16_t y;
+    uint16_t z;
+    uint8_t material;
+    uint8_t color;          // 1-based palette index
+};
+
+struct VmxsNode {
+    uint32_t id;            // String offset, the scene.json UUID
+    int32_t parent;         // Group index, -1 for world
+    uint32_t model;         // Model index for instances, UINT32_MAX for groups
+    uint32_t reserved;
+    double xform[16];       // Local matrix, row major, translation in the last row
+};
+
+static_assert(sizeof(VmxsSection) == 24, "VmxsSection layout");
+static_assert(sizeof(VmxsPalette) == 1024 + 8 * 16, "VmxsPalette layout");
+static_assert(sizeof(VmxsModel) == 40, "VmxsModel layout");
+static_assert(sizeof(VmxsChunk) == 24, "VmxsChunk layout");
+static_assert(sizeof(VmxsVoxel) == 8, "VmxsVoxel layout");
+static_assert(sizeof(VmxsNode) == 144, "VmxsNode layout");
+
+/**
+ * One model as collected during decode, before dedup touches it
+ */
+struct IntermediateModel {
+    std::string name;
+    uint32_t palette = 0;
+    VoxelBounds bounds;
+    std::vector<RawChunk> chunks;
+};
+
+/**
+ * Everything writeSceneIntermediate needs besides scene.json
+ */
+struct IntermediateScene {
+    std::vector<std::shared_ptr<const DecodedPalette>> palettes;
+    std::vector<IntermediateModel> models;
 
-    // Cleanup resources in destructor
-    ~MyEngineObserver() {
-        setString(nullptr);
+    uint32_t paletteIndex(const std::shared_ptr<const DecodedPalette>& palette) {
+        auto found = std::find(palettes.begin(), palettes.end(), palette);
+        if (found != palettes.end()) {
+            return static_cast<uint32_t>(found - palettes.begin());
+        }
+        palettes.push_back(palette);
+        return static_cast<uint32_t>(palettes.size() - 1);
     }
-private:
-    // Thread-safe pointer to current progress string
-    std::atomic<std::string*> progressPtr{nullptr};
 
-    // Helper function to safely update the progress string
-    void setString(std::string* newStatus) {
-        std::string* oldStatus = progressPtr.exchange(newStatus);
-        delete oldStatus;  // Clean up old string if it exists
+    void addModel(const std::string& name, uint32_t palette, std::vector<RawChunk>&& chunks) {
+        IntermediateModel model;
+        model.name = name;
+        model.palette = palette;
+        for (const RawChunk& chunk : chunks) {
+            for (const auto& voxel : chunk.voxels) {
+                model.bounds.add(voxel.x, voxel.y, voxel.z);
+            }
+        }
+        model.chunks = std::move(chunks);
+        models.push_back(std::move(model));
     }
 };
 
+/**
+ * Serializes the scene and the scene.json hierarchy through a temporary file and rename,
+ * so a concurrent reader never maps a partial file. Returns false with error set if a
+ * voxel does not fit the 16 bit fields or the file could not be written.
+ */
+template <typename ModelContentMap>
+bool writeSceneIntermediate(const std::string& path, 
+                            const IntermediateScene& scene, 
+                            const std::map<std::string, oom::vmax::JsonGroupInfo>& jsonGroups, 
+                            const ModelContentMap& modelVmaxbMap, 
+                            std::string& error) {
+    std::string strings;
+    auto addString = [&strings](const std::string& value) {
+        uint32_t offset = static_cast<uint32_t>(strings.size());
+        strings.append(value);
+        strings.push_back('\0');
+        return offset;
+    };
+    auto localMatrix = [](const auto& info, double* xform) {
+        oom::vmax::Matrix4x4 mat = oom::vmax::combineTransforms(info.rotation[0], info.rotation[1], info.rotation[2], info.rotation[3],
+                                                                info.position[0], info.position[1], info.position[2], 
+                                                                info.scale[0], info.scale[1], info.scale[2]);
+        for (int i = 0; i < 16; i++) {
+            xform[i] = mat.m[i / 4][i % 4];
+        }
+    };
 
+    std::vector<VmxsPalette> palettes(scene.palettes.size());
+    for (size_t p = 0; p < scene.palettes.size(); p++) {
+        const DecodedPalette& palette = *scene.palettes[p];
+        for (size_t c = 0; c < 256 && c < palette.colors.size(); c++) {
+            palettes[p].rgba[c][0] = palette.colors[c].r;
+            palettes[p].rgba[c][1] = palette.colors[c].g;
+            palettes[p].rgba[c][2] = palette.colors[c].b;
+            palettes[p].rgba[c][3] = palette.colors[c].a;
+        }
+        for (size_t m = 0; m < 8; m++) {
+            palettes[p].materials[m] = VmxsMaterial{palette.materials[m].transmission, palette.materials[m].roughness, 
+                                                    palette.materials[m].metalness, palette.materials[m].emission};
+        }
+    }
 
-//==============================================================================
-// MAIN FUNCTION - Discord bot entry point
-//==============================================================================
+    std::vector<VmxsModel> models;
+    std::vector<VmxsChunk> chunks;
+    std::vector<VmxsVoxel> voxels;
+    std::map<std::string, uint32_t> modelIndex;
+    for (const IntermediateModel& model : scene.models) {
+        if (!model.bounds.empty() && 
+            (model.bounds.min[0] < 0 || model.bounds.min[1] < 0 || model.bounds.min[2] < 0 || 
+             model.bounds.max[0] > 0xffff || model.bounds.max[1] > 0xffff || model.bounds.max[2] > 0xffff)) {
+            error = model.name + " has voxels outside 0-65535";
+            return false;
+        }
+        VmxsModel record{};
+        record.name = addString(model.name);
+        record.palette = model.palette;
+        for (int axis = 0; axis < 3; axis++) {
+            record.min[axis] = model.bounds.min[axis];
+            record.max[axis] = model.bounds.max[axis];
+        }
+        record.first_chunk = static_cast<uint32_t>(chunks.size());
+        record.chunk_count = static_cast<uint32_t>(model.chunks.size());
+        for (const RawChunk& chunk : model.chunks) {
+            chunks.push_back(VmxsChunk{static_cast<uint32_t>(chunk.info.id), static_cast<uint32_t>(chunk.info.mortoncode), 
+                                       voxels.size(), chunk.voxels.size()});
+            for (const auto& voxel : chunk.voxels) {
+                voxels.push_back(VmxsVoxel{static_cast<uint16_t>(voxel.x), static_cast<uint16_t>(voxel.y), static_cast<uint16_t>(voxel.z), 
+                                           static_cast<uint8_t>(voxel.material), static_cast<uint8_t>(voxel.palette)});
+            }
+        }
+        modelIndex[model.name] = static_cast<uint32_t>(models.size());
+        models.push_back(record);
+    }
 
-int DL_main(dl::Args& args) {
-    // Fix locale issues early
-    try {
-        std::locale::global(std::locale("C"));
-        setenv("LC_ALL", "C", 1);
-        setenv("LANG", "C", 1);
-        std::cout << "✅ Set system locale to 'C' for compatibility" << std::endl;
-    } catch (const std::exception& e) {
-        std::cout << "⚠️ Could not set initial locale: " << e.what() << std::endl;
+    std::map<std::string, int32_t> groupIndex;
+    for (const auto& [groupId, groupInfo] : jsonGroups) {
+        groupIndex[groupId] = static_cast<int32_t>(groupIndex.size());
     }
+    auto parentIndex = [&groupIndex](const std::string& parentId) {
+        auto found = groupIndex.find(parentId);
+        return found == groupIndex.end() ? -1 : found->second;
+    };
 
-    // Setup Bella logging callbacks
-    int s_oomBellaLogContext = 0; 
-    dl::subscribeLog(&s_oomBellaLogContext, oom::bella::log);
-    dl::flushStartupMessages();
+    std::vector<VmxsNode> groups;
+    for (const auto& [groupId, groupInfo] : jsonGroups) {
+        VmxsNode node{};
+        node.id = addString(groupId);
+        node.parent = parentIndex(groupInfo.parentId);
+        node.model = UINT32_MAX;
+        localMatrix(groupInfo, node.xform);
+        groups.push_back(node);
+    }
 
-    // Add command line arguments
-    args.add("tp", "thirdparty",    "",   "prints third party licenses");
-    args.add("li", "licenseinfo",   "",   "prints license info");
-    args.add("t",  "token",         "",   "Discord bot token");
+    std::vector<VmxsNode> instances;
+    for (const auto& [vmaxContentName, vmaxModelList] : modelVmaxbMap) {
+        for (const auto& jsonModelInfo : vmaxModelList) {
+            auto model = modelIndex.find(jsonModelInfo.dataFile);
+            if (model == modelIndex.end()) {
+                continue;
+            }
+            VmxsNode node{};
+            node.id = addString(jsonModelInfo.id);
+            node.parent = parentIndex(jsonModelInfo.parentId);
+            node.model = model->second;
+            localMatrix(jsonModelInfo, node.xform);
+            instances.push_back(node);
+        }
+    }
 
-    if (args.helpRequested()) {
-        std::cout << args.help("poomer-discord-vmax (C) 2025 Harvey Fong","", "1.0") << std::endl;
-        return 0;
+    // Lay sections out back to back after the header, each 8 byte aligned
+    VmxsHeader header{};
+    std::memcpy(header.magic, "VMXS", 4);
+    header.version = kSceneIntermediateVersion;
+    header.section_count = VmxsSectionCount;
+    const void* sectionData[VmxsSectionCount] = {
+        palettes.data(), models.data(), chunks.data(), voxels.data(), groups.data(), instances.data(), strings.data()
+    };
+    const uint64_t sectionCounts[VmxsSectionCount] = {
+        palettes.size(), models.size(), chunks.size(), voxels.size(), groups.size(), instances.size(), strings.size()
+    };
+    const uint64_t sectionSizes[VmxsSectionCount] = {
+        palettes.size() * sizeof(VmxsPalette), models.size() * sizeof(VmxsModel), chunks.size() * sizeof(VmxsChunk), 
+        voxels.size() * sizeof(VmxsVoxel), groups.size() * sizeof(VmxsNode), instances.size() * sizeof(VmxsNode), strings.size()
+    };
+    uint64_t offset = (sizeof(VmxsHeader) + 7) & ~uint64_t(7);
+    for (uint32_t type = 0; type < VmxsSectionCount; type++) {
+        if (sectionCounts[type] > UINT32_MAX) {
+            error = "more than 2^32 records in one section";
+            return false;
+        }
+        header.sections[type] = VmxsSection{type, static_cast<uint32_t>(sectionCounts[type]), offset, sectionSizes[type]};
+        offset = (offset + sectionSizes[type] + 7) & ~uint64_t(7);
     }
-    
-    if (args.have("--licenseinfo")) {
-        std::cout << "poomer-discord-vmax (C) 2025 Harvey Fong" << std::endl;
-        std::cout << oom::license::printLicense() << std::endl;
-        return 0;
+
+    std::string tempPath = path + ".tmp";
+    std::error_code ec;
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            error = "cannot write " + tempPath;
+            return false;
+        }
+        const char padding[8] = {0};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        uint64_t written = sizeof(header);
+        for (uint32_t type = 0; type < VmxsSectionCount; type++) {
+            file.write(padding, header.sections[type].offset - written);
+            file.write(static_cast<const char*>(sectionData[type]), sectionSizes[type]);
+            written = header.sections[type].offset + sectionSizes[type];
+        }
+        if (!file) {
+            error = "failed writing " + tempPath;
+            file.close();
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
     }
- 
-    if (args.have("--thirdparty")) {
-        std::cout << oom::license::printBellaSDK() << "\n====\n" << std::endl;
-        std::cout << oom::license::printLZFSE() << "\n====\n" << std::endl;
-        std::cout << oom::license::printLibPlist() << "\n====\n" << std::endl;
-        std::cout << oom::license::printOpenGameTools() << "\n====\n" << std::endl;
-        return 0;
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        error = "cannot rename " + tempPath + ": " + ec.message();
+        std::filesystem::remove(tempPath, ec);
+        return false;
     }
+    return true;
+}
 
-    // Initialize Bella Engine
-    std::cout << "=== Discord VoxelMax Bot Startup ===" << std::endl;
-    std::cout << "🎨 Initializing Bella Engine..." << std::endl;
-    
-    dl::bella_sdk::Engine engine;
-    engine.scene().loadDefs();
-   
-    
+/**
+ * Read-only view of a .vmaxscene file, memory mapped where the platform allows
+ */
+class SceneIntermediateFile {
+public:
+    SceneIntermediateFile() = default;
+    SceneIntermediateFile(const SceneIntermediateFile&) = delete;
+    SceneIntermediateFile& operator=(const SceneIntermediateFile&) = delete;
 
+    ~SceneIntermediateFile() {
+        close();
+    }
 
-    //oom::bella::MyEngineObserver engineObserver;
-    MyEngineObserver engineObserver;
-    engine.subscribe(&engineObserver);
-    
-    std::cout << "✅ Bella Engine initialized" << std::endl;
+    void close() {
+#ifndef _WIN32
+        if (mapped) {
+            munmap(const_cast<unsigned char*>(data), size);
+        }
+#endif
+        data = nullptr;
+        size = 0;
+        mapped = false;
+        buffer.clear();
+    }
 
-    // Initialize work queue database
-    std::cout << "🗄️ Initializing work queue database..." << std::endl;
-    
-    WorkQueue work_queue;
-    if (!work_queue.initialize()) {
-        std::cerr << "❌ Failed to initialize work queue database" << std::endl;
-        return 1;
+    bool isOpen() const {
+        return data != nullptr;
     }
-    
-    // Get Discord bot token
-    std::string BOT_TOKEN;
-    if (args.have("--token")) {
-        BOT_TOKEN = args.value("--token").buf();
-        std::cout << "✅ Using token from command line" << std::endl;
-    } else {
-        BOT_TOKEN = getHiddenInput("Enter Discord Bot Token: ");
+
+    /**
+     * Maps the file and validates the header, section bounds and every record reference
+     * On failure the view is closed again, so isOpen() only holds for a usable file
+     */
+    bool open(const std::string& path, std::string& error) {
+        close();
+        if (!load(path, error) || !validate(error)) {
+            close();
+            return false;
+        }
+        return true;
     }
-    
-    if (BOT_TOKEN.empty()) {
-        std::cerr << "Error: Bot token cannot be empty!" << std::endl;
-        return 1;
+
+    const VmxsHeader& header() const {
+        return *reinterpret_cast<const VmxsHeader*>(data);
     }
 
-    // Create Discord bot instance
-	dpp::cluster bot(BOT_TOKEN, dpp::i_default_intents | dpp::i_message_content);
+    // Records of a section validated by open(); a T that does not fit the entry yields none
+    template <typename T>
+    const T* section(VmxsSectionType type, uint32_t& count) const {
+        const VmxsSection& entry = header().sections[type];
+        count = static_cast<uint64_t>(entry.count) * sizeof(T) <= entry.size ? entry.count : 0;
+        return reinterpret_cast<const T*>(data + entry.offset);
+    }
 
-    // Enable logging
-    bot.on_log(dpp::utility::cout_logger());
-    
-    // Start worker thread
-    std::cout << "🔧 Starting worker thread..." << std::endl;
-    std::thread worker(workerThread, &bot, &work_queue, &engine);
+    const char* string(uint32_t offset) const {
+        const VmxsSection& entry = header().sections[VmxsStrings];
+        return offset < entry.size ? reinterpret_cast<const char*>(data + entry.offset + offset) : "";
+    }
 
-    // Set up event handler for file uploads
-    bot.on_message_create([&work_queue](const dpp::message_create_t& event) {
-        
-        if (event.msg.author.is_bot()) {
-            return;
+    size_t fileSize() const {
+        return size;
+    }
+
+private:
+    // Maps the file, or reads it into memory where mmap is unavailable
+    bool load(const std::string& path, std::string& error) {
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "cannot open " + path;
+            return false;
         }
-        
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                data = static_cast<const unsigned char*>(mapping);
+                size = static_cast<size_t>(st.st_size);
+                mapped = true;
+            }
+        }
+        ::close(fd);
+#endif
+        if (!mapped) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                error = "cannot open " + path;
+                return false;
+            }
+            buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            data = buffer.data();
+            size = buffer.size();
+        }
+        return true;
+    }
+
+    // Header and section table first, then every record the scene build will index
+    bool validate(std::string& error) const {
+        if (size < sizeof(VmxsHeader) || std::memcmp(header().magic, "VMXS", 4) != 0) {
+            error = "not a .vmaxscene file";
+            return false;
+        }
+        if (header().version != kSceneIntermediateVersion || header().section_count != VmxsSectionCount) {
+            error = "unsupported .vmaxscene version " + std::to_string(header().version);
+            return false;
+        }
+        // Every entry must describe its own type and hold its records inside the file,
+        // so section() and string() can index without further checks
+        const uint64_t recordSizes[VmxsSectionCount] = {
+            sizeof(VmxsPalette), sizeof(VmxsModel), sizeof(VmxsChunk), sizeof(VmxsVoxel), sizeof(VmxsNode), sizeof(VmxsNode), 1
+        };
+        for (uint32_t type = 0; type < VmxsSectionCount; type++) {
+            const VmxsSection& section = header().sections[type];
+            if (section.type != type || section.offset % 8 != 0 || section.offset > size || 
+                section.size > size - section.offset || 
+                static_cast<uint64_t>(section.count) * recordSizes[type] > section.size) {
+                error = "corrupt section table";
+                return false;
+            }
+        }
+        const VmxsSection& strings = header().sections[VmxsStrings];
+        if (strings.size > 0 && data[strings.offset + strings.size - 1] != '\0') {
+            error = "unterminated string section";
+            return false;
+        }
+        return validateReferences(error);
+    }
+
+    // Scenes are built straight from the records, so every index, range, material slot and
+    // palette color is checked once here instead of at each use
+    bool validateReferences(std::string& error) const {
+        uint32_t paletteCount = 0, modelCount = 0, chunkCount = 0, voxelCount = 0, groupCount = 0, instanceCount = 0;
+        section<VmxsPalette>(VmxsPalettes, paletteCount);
+        const VmxsModel* models = section<VmxsModel>(VmxsModels, modelCount);
+        const VmxsChunk* chunks = section<VmxsChunk>(VmxsChunks, chunkCount);
+        const VmxsVoxel* voxels = section<VmxsVoxel>(VmxsVoxels, voxelCount);
+        const VmxsNode* groups = section<VmxsNode>(VmxsGroups, groupCount);
+        const VmxsNode* instances = section<VmxsNode>(VmxsInstances, instanceCount);
+        const uint64_t stringSize = header().sections[VmxsStrings].size;
+
+        for (uint32_t m = 0; m < modelCount; m++) {
+            const VmxsModel& model = models[m];
+            if (model.name >= stringSize || model.palette >= paletteCount || 
+                static_cast<uint64_t>(model.first_chunk) + model.chunk_count > chunkCount) {
+                error = "model " + std::to_string(m) + " out of range";
+                return false;
+            }
+        }
+        for (uint32_t c = 0; c < chunkCount; c++) {
+            if (chunks[c].first_voxel > voxelCount || chunks[c].voxel_count > voxelCount - chunks[c].first_voxel) {
+                error = "chunk " + std::to_string(c) + " out of range";
+                return false;
+            }
+        }
+        for (uint32_t v = 0; v < voxelCount; v++) {
+            if (voxels[v].material >= 8 || voxels[v].color == 0) {
+                error = "voxel " + std::to_string(v) + " has no valid material/color";
+                return false;
+            }
+        }
+        for (uint32_t g = 0; g < groupCount; g++) {
+            if (groups[g].id >= stringSize || groups[g].parent < -1 || groups[g].parent >= static_cast<int64_t>(groupCount)) {
+                error = "group " + std::to_string(g) + " out of range";
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < instanceCount; i++) {
+            if (instances[i].id >= stringSize || instances[i].model >= modelCount || 
+                instances[i].parent < -1 || instances[i].parent >= static_cast<int64_t>(groupCount)) {
+                error = "instance " + std::to_string(i) + " out of range";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    std::vector<unsigned char> buffer;
+};
+
+/**
+ * Palette of a .vmaxscene file back in the form the material code reads
+ */
+DecodedPalette paletteFromIntermediate(const VmxsPalette& filePalette) {
+    std::vector<oom::vmax::RGBA> colors(256);
+    for (size_t c = 0; c < colors.size(); c++) {
+        colors[c] = oom::vmax::RGBA{filePalette.rgba[c][0], filePalette.rgba[c][1], filePalette.rgba[c][2], filePalette.rgba[c][3]};
+    }
+    std::array<oom::vmax::Material, 8> materials{};
+    for (size_t m = 0; m < materials.size(); m++) {
+        materials[m].transmission = filePalette.materials[m].transmission;
+        materials[m].roughness = filePalette.materials[m].roughness;
+        materials[m].metalness = filePalette.materials[m].metalness;
+        materials[m].emission = filePalette.materials[m].emission;
+    }
+    return makeDecodedPalette(std::move(colors), materials);
+}
+
+/**
+ * Offline --inspect: prints the sections of a .vmaxscene file
+ */
+int inspectSceneIntermediate(const std::string& path) {
+    SceneIntermediateFile scene;
+    std::string error;
+    if (!scene.open(path, error)) {
+        std::cerr << "❌ " << path << ": " << error << std::endl;
+        return 1;
+    }
+
+    uint32_t paletteCount = 0, modelCount = 0, chunkCount = 0, voxelCount = 0, groupCount = 0, instanceCount = 0;
+    const VmxsPalette* palettes = scene.section<VmxsPalette>(VmxsPalettes, paletteCount);
+    const VmxsModel* models = scene.section<VmxsModel>(VmxsModels, modelCount);
+    const VmxsChunk* chunks = scene.section<VmxsChunk>(VmxsChunks, chunkCount);
+    const VmxsVoxel* voxels = scene.section<VmxsVoxel>(VmxsVoxels, voxelCount);
+    const VmxsNode* groups = scene.section<VmxsNode>(VmxsGroups, groupCount);
+    const VmxsNode* instances = scene.section<VmxsNode>(VmxsInstances, instanceCount);
+
+    std::cout << "📄 " << path << " (.vmaxscene v" << scene.header().version << ", " << scene.fileSize() << " bytes)" << std::endl;
+    std::cout << "   " << paletteCount << " palettes, " << modelCount << " models, " << chunkCount << " chunks, " 
+              << voxelCount << " voxels, " << groupCount << " groups, " << instanceCount << " instances" << std::endl;
+
+    for (uint32_t p = 0; p < paletteCount; p++) {
+        std::cout << "🎨 palette " << p << " materials:";
+        for (const VmxsMaterial& material : palettes[p].materials) {
+            std::cout << " [r" << material.roughness << " m" << material.metalness 
+                      << " t" << material.transmission << " e" << material.emission << "]";
+        }
+        std::cout << std::endl;
+    }
+    for (uint32_t m = 0; m < modelCount; m++) {
+        const VmxsModel& model = models[m];
+        uint64_t modelVoxels = 0;
+        std::set<std::pair<int, int>> buckets;
+        for (uint32_t c = model.first_chunk; c < model.first_chunk + model.chunk_count; c++) {
+            modelVoxels += chunks[c].voxel_count;
+            for (uint64_t v = chunks[c].first_voxel; v < chunks[c].first_voxel + chunks[c].voxel_count; v++) {
+                buckets.insert({voxels[v].material, voxels[v].color});
+            }
+        }
+        std::cout << "📦 " << scene.string(model.name) << " palette " << model.palette 
+                  << " aabb (" << model.min[0] << "," << model.min[1] << "," << model.min[2] << ")-(" 
+                  << model.max[0] << "," << model.max[1] << "," << model.max[2] << ") " 
+                  << model.chunk_count << " chunks, " << buckets.size() << " material/color buckets, " 
+                  << modelVoxels << " voxels" << std::endl;
+    }
+    for (uint32_t g = 0; g < groupCount; g++) {
+        std::cout << "🗂️ group " << scene.string(groups[g].id) << " parent " << groups[g].parent << std::endl;
+    }
+    for (uint32_t i = 0; i < instanceCount; i++) {
+        std::cout << "🎪 instance " << scene.string(instances[i].id) << " model " << instances[i].model 
+                  << " parent " << instances[i].parent << " at (" 
+                  << instances[i].xform[12] << ", " << instances[i].xform[13] << ", " << instances[i].xform[14] << ")" << std::endl;
+    }
+    return 0;
+}
+
+//==============================================================================
+// VMAX PROCESSING FUNCTIONS
+//==============================================================================
+
+/**
+ * Builds the per-process template scene: camera, environment, beauty pass, voxel
+ * prototypes, bevel and the jpg output path. Jobs add and remove their own subtree on top.
+ */
+void buildTemplateScene(dl::bella_sdk::Engine& engine) {
+    auto belScene = engine.scene();
+    oom::bella::defaultScene2025(belScene);
+    oom::bella::defaultSceneVoxel(belScene);
+
+    belScene.beautyPass()["outputExt"] = ".jpg";
+    auto imgOutputPath = belScene.createNode("outputImagePath", "vmaxOutputPath");
+    imgOutputPath["ext"] = ".jpg";
+    imgOutputPath["dir"] = ".";
+    belScene.beautyPass()["saveImage"] = dl::Int(1);  // ENABLE image saving!
+    belScene.beautyPass()["overridePath"] = imgOutputPath;
+}
+
+/**
+ * Function to process .vmax.zip file and convert to rendered output
+ */
+std::string processVmaxFile(dl::bella_sdk::Engine& engine, RenderSignal& renderSignal, const ConvertOptions& options, PaletteCache& paletteCache, const std::vector<uint8_t>& vmax_data, const std::string& filename, const RenderRequest& request, WorkQueue* work_queue, JobStatusBoard* status_board, const std::function<void(const std::string&)>& onPreview, const std::vector<OrbitEngine*>& orbitEngines, int64_t item_id) {
+    std::cout << "🔄 Processing .vmax.zip file (" << vmax_data.size() << " bytes)..." << std::endl;
+    auto job_start = std::chrono::steady_clock::now();
+    
+    // Fix locale issues for Bella Engine
+    try {
+        std::locale::global(std::locale("C"));
+        std::cout << "✅ Set locale to 'C' for Bella Engine compatibility" << std::endl;
+    } catch (const std::exception& e) {
+        std::cout << "⚠️ Could not set locale: " << e.what() << std::endl;
+    }
+    
+    // Everything this job writes lives under its own scratch directory
+    std::string job_dir = jobScratchDir(item_id);
+    std::string output_dir = job_dir + "/output";
+    std::filesystem::remove_all(job_dir);
+    std::filesystem::create_directories(output_dir);
+
+    // Save .vmax.zip data to the job's scratch directory
+    std::string temp_vmax_filename = job_dir + "/upload.vmax.zip";
+    std::ofstream temp_vmax_file(temp_vmax_filename, std::ios::binary);
+    temp_vmax_file.write(reinterpret_cast<const char*>(vmax_data.data()), vmax_data.size());
+    temp_vmax_file.close();
+    
+    std::cout << "💾 Saved .vmax.zip to working file: " << temp_vmax_filename << std::endl;
+    
+    // Extract the zip file next to it
+    std::string work_dir = job_dir + "/vmax";
+    std::string temp_extract_dir = job_dir + "/extract";
+    
+    // First extract to temp directory
+    std::string unzip_cmd = "unzip -o -d " + temp_extract_dir + " " + temp_vmax_filename;
+    std::cout << "📦 Extracting: " << unzip_cmd << std::endl;
+    
+    int unzip_result = system(unzip_cmd.c_str());
+    if (unzip_result != 0) {
+        std::cout << "❌ Failed to extract .vmax.zip file" << std::endl;
+        std::remove(temp_vmax_filename.c_str());
+        return "";
+    }
+    
+    // Find the .vmax directory and move its contents to work directory
+    std::filesystem::remove_all(work_dir); // Clean any existing work directory
+    std::filesystem::create_directories(work_dir);
+    
+    // Look for .vmax directory in extracted files
+    bool found_vmax_dir = false;
+    for (const auto& entry : std::filesystem::directory_iterator(temp_extract_dir)) {
+        if (entry.is_directory() && entry.path().extension() == ".vmax") {
+            std::cout << "📁 Found .vmax directory: " << entry.path().filename() << std::endl;
+            
+            // Copy contents to work directory
+            for (const auto& file : std::filesystem::recursive_directory_iterator(entry.path())) {
+                if (file.is_regular_file()) {
+                    auto rel_path = std::filesystem::relative(file.path(), entry.path());
+                    auto dest_path = work_dir + "/" + rel_path.string();
+                    
+                    // Create parent directories if needed
+                    std::filesystem::create_directories(std::filesystem::path(dest_path).parent_path());
+                    std::filesystem::copy_file(file.path(), dest_path, std::filesystem::copy_options::overwrite_existing);
+                }
+            }
+            found_vmax_dir = true;
+            break;
+        }
+    }
+    
+    // Clean up temp extraction directory
+    std::filesystem::remove_all(temp_extract_dir);
+    
+    if (!found_vmax_dir) {
+        std::cout << "❌ No .vmax directory found in extracted files" << std::endl;
+        std::remove(temp_vmax_filename.c_str());
+        std::filesystem::remove_all(work_dir);
+        return "";
+    }
+    
+    try {
+        // Template scene was built once at startup, this job only adds its own subtree
+        // under belWorld; belJob deletes it again when it goes out of scope
+        JobScene belJob(engine.scene(), dl::String::format("vmaxJob%lld", static_cast<long long>(item_id)));
+        auto belScene = belJob.scene;
+        dl::bella_sdk::Node belWorld = belJob.root;
+        
+        // Extract base filename for output
+        std::string base_filename = uploadBaseName(filename);
+        
+        std::cout << "📷 Setting output filename to: " << output_dir << "/" << base_filename << ".jpg" << std::endl;
+        belJob.setOutputDir(output_dir.c_str());
+        
+        belScene.beautyPass()["outputName"] = base_filename.c_str();
+
+        // Process the VMAX scene
+        dl::String vmaxDirName = work_dir.c_str();
+        
+        std::cout << "🎯 Processing VMAX scene from: " << vmaxDirName.buf() << std::endl;
+        
+        // Parse scene.json
+        oom::vmax::JsonSceneParser vmaxSceneParser;
+        std::string scene_json_path = work_dir + "/scene.json";
+        
+        if (!std::filesystem::exists(scene_json_path)) {
+            std::cout << "❌ scene.json not found in extracted files" << std::endl;
+            return "";
+        }
+        
+        vmaxSceneParser.parseScene(scene_json_path.c_str());
+        
+        std::map<std::string, oom::vmax::JsonGroupInfo> jsonGroups = vmaxSceneParser.getGroups();
+        // Both keyed by the raw scene.json strings (group id, dataFile) so lookups need no string rebuilding
+        std::unordered_map<std::string, dl::bella_sdk::Node> belGroupNodes;
+        std::unordered_map<std::string, dl::bella_sdk::Node> belCanonicalNodes;
+        belGroupNodes.reserve(jsonGroups.size());
+
+        // Parent of every group with parentId cycles cut, so groupNode never loops
+        std::map<std::string, std::string> groupParents = acyclicGroupParents(jsonGroups);
+        // World matrix of every group, used for the camera bbox and by --flattengroups
+        std::map<std::string, oom::vmax::Matrix4x4> groupWorld = groupWorldMatrices(jsonGroups, groupParents);
+
+        // Batch scene events for the whole conversion; reset once the instances are placed
+        std::optional<dl::bella_sdk::Scene::EventScope> sceneEvents;
+        sceneEvents.emplace(belScene);
+
+        // Returns the group's xform, creating and parenting it (and its parents) on first use
+        // The chain is climbed in a loop so nesting depth is not bounded by the stack
+        std::vector<std::string> groupChain;
+        auto groupNode = [&](const std::string& groupName) -> dl::bella_sdk::Node {
+            groupChain.clear();
+            std::string current = groupName;
+            while (!current.empty() && jsonGroups.count(current) && !belGroupNodes.count(current)) {
+                groupChain.push_back(current);
+                current = groupParents[current];
+            }
+            auto created = belGroupNodes.find(current);
+            dl::bella_sdk::Node belParent = created != belGroupNodes.end() ? created->second : belWorld;
+
+            for (auto it = groupChain.rbegin(); it != groupChain.rend(); ++it) {
+                const oom::vmax::JsonGroupInfo& groupInfo = jsonGroups.at(*it);
+                dl::String belGroupUUID = belNodeId(*it);
+                auto belGroup = belJob.createNode("xform", belGroupUUID, belGroupUUID);
+                belGroupNodes[*it] = belGroup;
+
+                oom::vmax::Matrix4x4 objectMat4 = oom::vmax::combineTransforms(groupInfo.rotation[0], 
+                                                  groupInfo.rotation[1], 
+                                                  groupInfo.rotation[2], 
+                                                  groupInfo.rotation[3],
+                                                  groupInfo.position[0], 
+                                                  groupInfo.position[1], 
+                                                  groupInfo.position[2], 
+                                                  groupInfo.scale[0], 
+                                                  groupInfo.scale[1], 
+                                                  groupInfo.scale[2]);
+
+                belGroup["steps"][0]["xform"] = dl::Mat4({
+                    objectMat4.m[0][0], objectMat4.m[0][1], objectMat4.m[0][2], objectMat4.m[0][3],
+                    objectMat4.m[1][0], objectMat4.m[1][1], objectMat4.m[1][2], objectMat4.m[1][3],
+                    objectMat4.m[2][0], objectMat4.m[2][1], objectMat4.m[2][2], objectMat4.m[2][3],
+                    objectMat4.m[3][0], objectMat4.m[3][1], objectMat4.m[3][2], objectMat4.m[3][3]
+                    });
+                belGroup.parentTo(belParent);
+                belParent = belGroup;
+            }
+            return belParent;
+        };
+
+        // Process models
+        auto modelVmaxbMap = vmaxSceneParser.getModelContentVMaxbMap(); 
+        std::vector<oom::vmax::Model> allModels;
+        std::vector<std::shared_ptr<const DecodedPalette>> vmaxPalettes;
+        std::vector<std::vector<RepeatedChunk>> vmaxRepeatedChunks;
+        std::map<std::string, VoxelBounds> modelBounds;
+        SceneBuildStats buildStats;
+        
+        std::cout << "🎨 Processing " << modelVmaxbMap.size() << " unique models..." << std::endl;
+        if (status_board) {
+            status_board->setStage(item_id, "🔧 Converting `" + filename + "` (" + std::to_string(modelVmaxbMap.size()) + " models)");
+        }
+
+        // Decoding and scene building hand off through a .vmaxscene file. With --modelcache it
+        // is kept under the upload's SHA-256, so a retry or re-upload of the same bundle maps
+        // the earlier one and decodes nothing; otherwise it only lives for this job.
+        std::string scene_intermediate_path = options.model_cache_dir.empty() 
+            ? job_dir + "/scene.vmaxscene" 
+            : sceneIntermediatePath(options.model_cache_dir, sceneIntermediateKey(vmax_data));
+        SceneIntermediateFile sceneIntermediate;
+        std::string intermediate_error;
+        if (!options.model_cache_dir.empty() && std::filesystem::exists(scene_intermediate_path)) {
+            if (sceneIntermediate.open(scene_intermediate_path, intermediate_error)) {
+                std::error_code ec;
+                std::filesystem::last_write_time(scene_intermediate_path, std::filesystem::file_time_type::clock::now(), ec);
+                std::cout << "💽 Reusing decoded scene " << scene_intermediate_path << std::endl;
+            } else {
+                std::cout << "⚠️ Ignoring " << scene_intermediate_path << ": " << intermediate_error << std::endl;
+            }
+        }
+
+        if (!sceneIntermediate.isOpen()) {
+            std::unordered_map<std::string, std::shared_ptr<const DecodedPalette>> jobPalettes;
+            size_t palettesDecoded = 0;
+            size_t modelCacheHits = 0;
+            double cacheReadMs = 0.0;     // Loading hits from the model cache
+            double decodeMs = 0.0;        // Decoding misses, the work a hit saves
+            IntermediateScene intermediate;
+
+            for (const auto& [vmaxContentName, vmaxModelList] : modelVmaxbMap) { 
+                // Check for cancellation
+                if (work_queue && work_queue->shouldCancelCurrentJob()) {
+                    std::cout << "🛑 Cancelling vmax processing for job " << item_id << std::endl;
+                    work_queue->markCurrentJobCancelled();
+                    return "";
+                }
+                
+                std::cout << "📦 Decoding model: " << vmaxContentName << std::endl;
+                const auto& jsonModelInfo = vmaxModelList.front();
+
+                // Colors from paletteN.png and materials from paletteN.settings.vmaxpsb, 
+                // decoded once per palette file and reused across jobs with identical content
+                auto jobPalette = jobPalettes.find(jsonModelInfo.paletteFile);
+                if (jobPalette == jobPalettes.end()) {
+                    dl::String materialName = vmaxDirName + "/" + jsonModelInfo.paletteFile.c_str();
+                    materialName = materialName.replace(".png", ".settings.vmaxpsb");
+                    dl::String pngName = vmaxDirName + "/" + jsonModelInfo.paletteFile.c_str();
+                    bool decoded = false;
+                    auto palette = paletteCache.get(pngName.buf(), materialName.buf(), decoded);
+                    palettesDecoded += decoded ? 1 : 0;
+                    jobPalette = jobPalettes.emplace(jsonModelInfo.paletteFile, palette).first;
+                }
+
+                // Decoded chunks come from the model cache when this vmaxb/palette pair was seen before
+                dl::String modelFileName = vmaxDirName + "/" + jsonModelInfo.dataFile.c_str();
+                std::vector<RawChunk> rawChunks;
+                bool cachedModel = false;
+                ContentDigest cacheKey{};
+                if (!options.model_cache_dir.empty()) {
+                    dl::String pngName = vmaxDirName + "/" + jsonModelInfo.paletteFile.c_str();
+                    dl::String materialName = pngName.replace(".png", ".settings.vmaxpsb");
+                    cacheKey = modelCacheKey(modelFileName.buf(), pngName.buf(), materialName.buf());
+                    auto read_start = std::chrono::steady_clock::now();
+                    cachedModel = loadCachedModel(options.model_cache_dir, cacheKey, rawChunks);
+                    if (cachedModel) {
+                        modelCacheHits++;
+                        cacheReadMs += elapsedMs(read_start);
+                    }
+                }
+                if (!cachedModel) {
+                    auto decode_start = std::chrono::steady_clock::now();
+                    rawChunks = decodeVmaxbChunks(modelFileName.buf());
+                    decodeMs += elapsedMs(decode_start);
+                    if (!options.model_cache_dir.empty()) {
+                        storeCachedModel(options.model_cache_dir, cacheKey, rawChunks);
+                    }
+                }
+
+                intermediate.addModel(vmaxContentName, intermediate.paletteIndex(jobPalette->second), std::move(rawChunks));
+            }
+            std::cout << "🎨 Palettes: " << jobPalettes.size() << " used by " << modelVmaxbMap.size() 
+                      << " models, " << palettesDecoded << " decoded, " 
+                      << jobPalettes.size() - palettesDecoded << " reused from earlier jobs" << std::endl;
+            if (!options.model_cache_dir.empty()) {
+                std::cout << "💽 Model cache: " << modelCacheHits << " of " << modelVmaxbMap.size() 
+                          << " models loaded from " << options.model_cache_dir << " in " << cacheReadMs 
+                          << " ms, " << modelVmaxbMap.size() - modelCacheHits << " decoded in " << decodeMs << " ms" << std::endl;
+            }
+
+            if (!options.model_cache_dir.empty()) {
+                std::error_code ec;
+                std::filesystem::create_directories(options.model_cache_dir, ec);
+            }
+            if (!writeSceneIntermediate(scene_intermediate_path, intermediate, jsonGroups, modelVmaxbMap, intermediate_error) || 
+                !sceneIntermediate.open(scene_intermediate_path, intermediate_error)) {
+                std::cout << "❌ Decoded scene hand-off failed: " << intermediate_error << std::endl;
+                return "";
+            }
+            // One eviction pass per job, after every entry of this job was stored
+            if (!options.model_cache_dir.empty()) {
+                trimModelCache(options.model_cache_dir, options.model_cache_max_bytes);
+            }
+        }
+
+        // Models, their palettes and AABBs come from the mapped file, never from the decode above
+        {
+            uint32_t paletteCount = 0, modelCount = 0, chunkCount = 0, voxelCount = 0;
+            const VmxsPalette* filePalettes = sceneIntermediate.section<VmxsPalette>(VmxsPalettes, paletteCount);
+            const VmxsModel* fileModels = sceneIntermediate.section<VmxsModel>(VmxsModels, modelCount);
+            const VmxsChunk* fileChunks = sceneIntermediate.section<VmxsChunk>(VmxsChunks, chunkCount);
+            const VmxsVoxel* fileVoxels = sceneIntermediate.section<VmxsVoxel>(VmxsVoxels, voxelCount);
+
+            std::vector<std::shared_ptr<const DecodedPalette>> palettes;
+            palettes.reserve(paletteCount);
+            for (uint32_t p = 0; p < paletteCount; p++) {
+                palettes.push_back(std::make_shared<const DecodedPalette>(paletteFromIntermediate(filePalettes[p])));
+            }
+
+            for (uint32_t m = 0; m < modelCount; m++) {
+                // Check for cancellation
+                if (work_queue && work_queue->shouldCancelCurrentJob()) {
+                    std::cout << "🛑 Cancelling vmax processing for job " << item_id << std::endl;
+                    work_queue->markCurrentJobCancelled();
+                    return "";
+                }
+
+                const VmxsModel& fileModel = fileModels[m];
+                std::string vmaxContentName = sceneIntermediate.string(fileModel.name);
+                std::cout << "📦 Processing model: " << vmaxContentName << std::endl;
+                oom::vmax::Model currentVmaxModel(vmaxContentName);
+                vmaxPalettes.push_back(palettes[fileModel.palette]);
+
+                VoxelBounds& currentBounds = modelBounds[vmaxContentName];
+                for (int axis = 0; axis < 3; axis++) {
+                    currentBounds.min[axis] = fileModel.min[axis];
+                    currentBounds.max[axis] = fileModel.max[axis];
+                }
+
+                // Process snapshots
+                std::vector<DecodedChunk> decodedChunks;
+                for (uint32_t c = fileModel.first_chunk; c < fileModel.first_chunk + fileModel.chunk_count; c++) {
+                    const VmxsChunk& fileChunk = fileChunks[c];
+                    oom::vmax::ChunkInfo chunkInfo;
+                    chunkInfo.id = fileChunk.id;
+                    chunkInfo.mortoncode = fileChunk.mortoncode;
+
+                    // Hold chunks back until the whole model is read so repeats can be found
+                    if (options.dedup_chunks && fileChunk.voxel_count > 0) {
+                        std::vector<oom::vmax::Voxel> xvoxels(static_cast<size_t>(fileChunk.voxel_count));
+                        for (size_t v = 0; v < xvoxels.size(); v++) {
+                            const VmxsVoxel& fileVoxel = fileVoxels[fileChunk.first_voxel + v];
+                            xvoxels[v].x = fileVoxel.x;
+                            xvoxels[v].y = fileVoxel.y;
+                            xvoxels[v].z = fileVoxel.z;
+                            xvoxels[v].material = fileVoxel.material;
+                            xvoxels[v].palette = fileVoxel.color;
+                        }
+                        if (auto decoded = decodeChunkForDedup(chunkInfo, xvoxels)) {
+                            decodedChunks.push_back(std::move(*decoded));
+                            continue;
+                        }
+                        std::cout << "⚠️ Chunk " << chunkInfo.id << " of " << vmaxContentName 
+                                  << " spans more than one 32³ chunk, added without dedup" << std::endl;
+                    }
+
+                    for (uint64_t v = fileChunk.first_voxel; v < fileChunk.first_voxel + fileChunk.voxel_count; v++) {
+                        const VmxsVoxel& voxel = fileVoxels[v];
+                        currentVmaxModel.addVoxel(voxel.x, voxel.y, voxel.z, voxel.material, voxel.color, chunkInfo.id, chunkInfo.mortoncode);
+                    }
+                }
+                vmaxRepeatedChunks.push_back(dedupModelChunks(decodedChunks, currentVmaxModel, buildStats));
+                allModels.push_back(currentVmaxModel);
+            }
+            sceneIntermediate.close();
+        }
+
+        std::cout << "🏗️ Creating canonical models..." << std::endl;
+        
+        // Create canonical models
+        auto canonical_start = std::chrono::steady_clock::now();
+        int modelIndex = 0;
+        for (const auto& eachModel : allModels) {
+            // Check for cancellation
+            if (work_queue && work_queue->shouldCancelCurrentJob()) {
+                std::cout << "🛑 Cancelling vmax processing for job " << item_id << std::endl;
+                work_queue->markCurrentJobCancelled();
+                return "";
+            }
+            
+            std::cout << "🎨 Model " << modelIndex << ": " << eachModel.vmaxbFileName << " (voxels: " << eachModel.getTotalVoxelCount() << ")" << std::endl;
+            
+            dl::bella_sdk::Node belModel = addModelToScene(options, belJob, belWorld, eachModel, *vmaxPalettes[modelIndex], &buildStats);
+
+            // Repeated chunks: one canonical chunk node, one translate-only xform per occurrence
+            for (const auto& repeatedChunk : vmaxRepeatedChunks[modelIndex]) {
+                dl::bella_sdk::Node belChunk = addModelToScene(options, belJob, belWorld, repeatedChunk.model, *vmaxPalettes[modelIndex], &buildStats);
+                dl::String chunkName = dl::String(repeatedChunk.model.vmaxbFileName.c_str()).replace(".vmaxb", "");
+                for (size_t n = 0; n < repeatedChunk.origins.size(); n++) {
+                    const auto& origin = repeatedChunk.origins[n];
+                    auto belChunkXform = belJob.createNode("xform", chunkName + dl::String("Xform") + dl::String(static_cast<int>(n)));
+                    belChunkXform["steps"][0]["xform"] = dl::Mat4 {1,0,0,0, 0,1,0,0, 0,0,1,0, 
+                                                                   static_cast<double>(origin[0]), 
+                                                                   static_cast<double>(origin[1]), 
+                                                                   static_cast<double>(origin[2]), 1};
+                    belChunkXform.parentTo(belModel);
+                    belChunk.parentTo(belChunkXform);
+                }
+            }
+            belCanonicalNodes[eachModel.vmaxbFileName] = belModel;
+            modelIndex++;
+        }
+
+        // The caches hold decoded voxels only: meshing, box merging, the cost model and
+        // material nodes still run for every model, cached or not, and are timed here
+        std::cout << "⏱️ Built " << allModels.size() << " models in " << elapsedMs(canonical_start) << " ms" << std::endl;
+
+        if (buildStats.instance_count > 0) {
+            std::cout << "🧱 Voxel instances: " << buildStats.voxel_count << " voxels -> " 
+                      << buildStats.instance_count << " instances in " 
+                      << buildStats.instancer_count << " instancers (" 
+                      << static_cast<double>(buildStats.voxel_count) / buildStats.instance_count << "x reduction)" << std::endl;
+        }
+        if (options.dedup_chunks) {
+            std::cout << "♻️ Chunk dedup: " << buildStats.deduplicated_chunks << " of " 
+                      << buildStats.chunk_count << " chunks replaced by shared chunk instances" << std::endl;
+        }
+        if (buildStats.material_buckets > 0) {
+            std::cout << "🎨 Materials: " << buildStats.material_buckets << " material/color buckets -> " 
+                      << buildStats.material_nodes << " shared quickMaterial nodes" << std::endl;
+        }
+        if (buildStats.mesh_quads > 0) {
+            std::cout << "🔷 Mesh polygons: " << buildStats.mesh_faces << " exposed faces -> " 
+                      << buildStats.mesh_quads << " quads (" 
+                      << static_cast<double>(buildStats.mesh_faces) / buildStats.mesh_quads << "x reduction)" << std::endl;
+        }
+
+        std::cout << "🎪 Creating instances..." << std::endl;
+        auto instances_start = std::chrono::steady_clock::now();
+        size_t instanceCount = 0;
+        for (const auto& [vmaxContentName, vmaxModelList] : modelVmaxbMap) {
+            instanceCount += vmaxModelList.size();
+        }
+        belJob.reserve(instanceCount);
+        
+        // Create instances and their group chains in one pass
+        for (const auto& [vmaxContentName, vmaxModelList] : modelVmaxbMap) { 
+            for(const auto& jsonModelInfo : vmaxModelList) {
+                // Check for cancellation
+                if (work_queue && work_queue->shouldCancelCurrentJob()) {
+                    std::cout << "🛑 Cancelling vmax processing for job " << item_id << std::endl;
+                    work_queue->markCurrentJobCancelled();
+                    return "";
+                }
+                
+                const std::vector<double>& position = jsonModelInfo.position;
+                const std::vector<double>& rotation = jsonModelInfo.rotation;
+                const std::vector<double>& scale = jsonModelInfo.scale;
+                const std::string& jsonParentId = jsonModelInfo.parentId;
+
+                auto canonicalIt = belCanonicalNodes.find(jsonModelInfo.dataFile);
+                if (canonicalIt == belCanonicalNodes.end()) {
+                    std::cout << "⚠️ No model for instance " << jsonModelInfo.id << " (" << jsonModelInfo.dataFile << ")" << std::endl;
+                    continue;
+                }
+
+                dl::String belObjectId = belNodeId(jsonModelInfo.id);
+
+                oom::vmax::Matrix4x4 objectMat4 = oom::vmax::combineTransforms(rotation[0], rotation[1], rotation[2], rotation[3],
+                                                                 position[0], position[1], position[2], 
+                                                                 scale[0], scale[1], scale[2]);
+                auto parentWorld = options.flatten_groups ? groupWorld.find(jsonParentId) : groupWorld.end();
+                if (parentWorld != groupWorld.end()) {
+                    objectMat4 = multiplyMatrices(objectMat4, parentWorld->second);
+                }
+
+                auto belNodeObjectInstance = belJob.createNode("xform", belObjectId, belObjectId);
+                belNodeObjectInstance["steps"][0]["xform"] = dl::Mat4({
+                    objectMat4.m[0][0], objectMat4.m[0][1], objectMat4.m[0][2], objectMat4.m[0][3],
+                    objectMat4.m[1][0], objectMat4.m[1][1], objectMat4.m[1][2], objectMat4.m[1][3],
+                    objectMat4.m[2][0], objectMat4.m[2][1], objectMat4.m[2][2], objectMat4.m[2][3],
+                    objectMat4.m[3][0], objectMat4.m[3][1], objectMat4.m[3][2], objectMat4.m[3][3]
+                    });
+
+                if (jsonParentId == "" || options.flatten_groups) {
+                    belNodeObjectInstance.parentTo(belWorld);
+                } else {
+                    belNodeObjectInstance.parentTo(groupNode(jsonParentId));
+                }
+                canonicalIt->second.parentTo(belNodeObjectInstance);
+            }
+        }
+        sceneEvents.reset();
+        std::cout << "⏱️ " << instanceCount << " instances in " << belGroupNodes.size() 
+                  << " groups placed in " << elapsedMs(instances_start) << " ms" << std::endl;
+
+        // Position camera to view the entire scene
+        std::cout << "📷 Setting up camera positioning..." << std::endl;
+        
+        // Zoom extents bbox from per-model bounds and the scene.json instance/group matrices
+        dl::Aabb sceneBbox = sceneBoundsFromModels(modelVmaxbMap, groupWorld, modelBounds);
+
+        if (sceneBbox.min.x <= sceneBbox.max.x) {
+            auto center = ( sceneBbox.min.v3 + sceneBbox.max.v3 ) * 0.5;
+            auto radius =dl::math::norm( sceneBbox.max - sceneBbox.min ) * 0.5;
+            dl::bella_sdk::zoomExtents(belScene.cameraPath(), dl::Vec3{center.x, center.y, center.z}, radius);       
+            std::cout << "✅ Camera positioning complete" << std::endl;
+        } else {
+            std::cout << "⚠️ Scene has no voxels, keeping default camera" << std::endl;
+        }
+
+        auto belCamera = belScene.camera();
+
+        // Orbit camera slightly for better view
+        auto offset1 = dl::Vec2 {-45, 0.0};
+        belJob.orbitCamera(offset1);
+        
+        // Debug copies go to --debugdir under the job id, never into the working directory
+        if (options.write_intermediate) {
+            std::string intermediate_filename = debugDumpPath(options.debug_dir, item_id, ".vmaxscene");
+            std::error_code ec;
+            std::filesystem::copy_file(scene_intermediate_path, intermediate_filename, 
+                                       std::filesystem::copy_options::overwrite_existing, ec);
+            if (!ec) {
+                std::cout << "💾 Saved scene intermediate: " << intermediate_filename << std::endl;
+            } else {
+                std::cout << "⚠️ Failed to save scene intermediate: " << intermediate_filename << std::endl;
+            }
+        }
+
+        if (!options.debug_dir.empty()) {
+            std::string bsz_filename = debugDumpPath(options.debug_dir, item_id, ".bsz");
+            std::cout << "💾 Saving Bella scene file for debugging: " << bsz_filename << std::endl;
+            try {
+                belScene.write(bsz_filename.c_str());
+                std::cout << "✅ Bella scene saved: " << bsz_filename << std::endl;
+            } catch (const std::exception& e) {
+                std::cout << "⚠️ Failed to save Bella scene file: " << e.what() << std::endl;
+            }
+        }
+
+        std::cout << "⏱️ Scene ready " << elapsedMs(job_start) << " ms after download (" 
+                  << belJob.nodeCount() << " job nodes)" << std::endl;
+
+        // Mark bella start time
+        if (work_queue) {
+            work_queue->markBellaStarted(item_id);
+        }
+
+        // Starts a render and sleeps until it stops or the job is cancelled
+        auto renderAndWait = [&](bool captureFrame = false) {
+            renderSignal.arm(captureFrame);
+            engine.start();
+            return renderSignal.wait(engine, [work_queue]() { 
+                return work_queue && work_queue->shouldCancelCurrentJob(); 
+            });
+        };
+
+        // Options from the upload message: resolution and view hold for the preview too
+        if (request.resolution > 0 && request.orbit_frames == 0) {
+            belJob.setRenderResolution(request.resolution);
+        }
+        if (!request.view.empty()) {
+            belJob.orbitCamera(viewOrbitOffset(request.view));
+        }
+
+        int orbit_frames = request.orbit_frames;
+
+        // Orbits use a square frame, 320 unless res= asked otherwise, scaled by the tier below
+        const int orbit_base_side = request.resolution > 0 ? request.resolution : 320;
+
+        // Quality follows the queue: the deeper it is, the cheaper this job renders
+        // Picked before the preview so the queue depth is the one this job was waiting behind
+        RenderTier tier = chooseRenderTier(options, request.quality, request.raise_quality, 
+                                           work_queue ? work_queue->pendingCount() : 0, 
+                                           buildStats, orbit_frames, 
+                                           orbit_frames > 0 ? dl::Vec2{static_cast<double>(orbit_base_side), 
+                                                                       static_cast<double>(orbit_base_side)} 
+                                                            : belJob.resolution());
+        if (request.noise > 0) {
+            tier.target_noise = request.noise;
+        }
+        if (work_queue) {
+            work_queue->setQualityTier(item_id, tier.name);
+        }
+
+        // Quick low resolution render of the same scene, handed to onPreview while the final renders
+        if (options.preview_size > 0 && onPreview) {
+            std::cout << "👀 Rendering " << options.preview_size << "px preview..." << std::endl;
+            if (status_board) {
+                status_board->setStage(item_id, "👀 Rendering preview of `" + filename + "`");
+            }
+            auto preview_start = std::chrono::steady_clock::now();
+            std::string preview_name = base_filename + "_preview";
+            belJob.usePreviewSettings(options.preview_size);
+            belScene.beautyPass()["outputName"] = preview_name.c_str();
+
+            RenderSignal::Outcome outcome = renderAndWait();
+
+            belJob.restoreRenderSettings();
+            belScene.beautyPass()["outputName"] = base_filename.c_str();
+            if (outcome == RenderSignal::Outcome::Cancelled) {
+                std::cout << "🛑 Cancelling preview render for job " << item_id << std::endl;
+                engine.stop();
+                work_queue->markCurrentJobCancelled();
+                std::filesystem::remove_all(work_dir);
+                std::remove(temp_vmax_filename.c_str());
+                return "";
+            }
+            if (outcome == RenderSignal::Outcome::Failed) {
+                // The final render may still succeed, so only the preview is dropped
+                std::cout << "⚠️ Preview render failed: " << renderSignal.lastError() << std::endl;
+            } else {
+                std::cout << "✅ Preview ready " << elapsedMs(preview_start) << " ms after scene build" << std::endl;
+                onPreview(output_dir + "/" + preview_name + ".jpg");
+            }
+        }
+
+        belJob.applyRenderTier(tier);
+        
+        if (orbit_frames > 0) {
+            // Orbit camera animation rendering
+            std::cout << "🎨 Starting orbit animation with " << orbit_frames << " frames..." << std::endl;
+            
+            // chooseRenderTier already kept the scaled side at or above the quality floor
+            int orbit_side = std::max(1, static_cast<int>(std::round(orbit_base_side * tier.resolution_scale)));
+            belCamera["resolution"] = dl::Vec2{static_cast<double>(orbit_side), static_cast<double>(orbit_side)};
+
+            // Frames go from onImage straight into ffmpeg's stdin, encoding while the next one renders
+            // The path goes through a shell, so it is built from the job id only; the upload's
+            // name is given to the attachment when it is sent
+            std::string output_mp4 = output_dir + "/orbit.mp4";
+            FrameEncoder encoder(output_mp4, request.fps);
+            belScene.beautyPass()["saveImage"] = dl::Int(0);
+
+            // Frame i is rendered from the absolute angle 360*i/N degrees, measured from the
+            // pose the orbit starts in. Each renderer remembers the angle its camera is at and
+            // orbits by the difference, so any engine can render any frame in any order.
+            struct OrbitRenderer {
+                dl::bella_sdk::Engine* engine;
+                RenderSignal* signal;
+                std::function<void(const dl::Vec2&)> orbit;
+                dl::Vec2 applied{0.0, 0.0};
+                int frames = 0;
+                double first_setup_ms = 0.0;    // Time to first progress of the engine's first frame
+                double later_setup_ms = 0.0;    // Same for every later frame, summed
+                double sampling_ms = 0.0;
+            };
+            std::vector<OrbitRenderer> renderers;
+            // Every frame is a full engine start, as before; only the camera moves between
+            // frames, as one batched scene event. Nothing here keeps the translated scene
+            // resident, the setup and sampling times logged per frame only measure what each
+            // restart costs
+            renderers.push_back({&engine, &renderSignal, [&belJob](const dl::Vec2& offset) {
+                dl::bella_sdk::Scene::EventScope cameraEvents(belJob.scene);
+                belJob.orbitCamera(offset);
+            }});
+            int threads_per_engine = 0;
+            if (!orbitEngines.empty() && orbit_frames > 1) {
+                // Every engine would otherwise start one thread per core; split the cores instead
+                unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+                threads_per_engine = std::max(1, static_cast<int>(cores / (orbitEngines.size() + 1)));
+                belJob.setRenderThreads(threads_per_engine);
+
+                // Extra engines start from a snapshot with resolution, tier, threads and camera pose already applied
+                std::string orbit_bsz = job_dir + "/orbit.bsz";
+                if (belScene.write(orbit_bsz.c_str())) {
+                    for (OrbitEngine* helper : orbitEngines) {
+                        if (!helper->loadSnapshot(orbit_bsz)) {
+                            std::cout << "⚠️ Orbit engine could not load " << orbit_bsz << std::endl;
+                            continue;
+                        }
+                        auto helperScene = helper->engine.scene();
+                        renderers.push_back({&helper->engine, &helper->signal, [helperScene](const dl::Vec2& offset) mutable {
+                            dl::bella_sdk::Scene::EventScope cameraEvents(helperScene);
+                            dl::bella_sdk::orbitCamera(helperScene.cameraPath(), offset);
+                        }});
+                    }
+                }
+            }
+            std::cout << "🎞️ Rendering " << orbit_frames << " frames on " << renderers.size() << " engine(s), " 
+                      << (threads_per_engine > 0 ? std::to_string(threads_per_engine) : std::string("all")) << " threads each" << std::endl;
+
+            // Frames finish out of order and are handed to the encoder strictly in order
+            auto orbit_start = std::chrono::steady_clock::now();
+            std::atomic<int> next_frame{0};
+            std::atomic<bool> cancelled{false};
+            std::atomic<bool> failed{false};
+            std::mutex frames_mutex;
+            std::condition_variable frames_drained;
+            std::map<int, RenderFrame> finished_frames;
+            int next_to_encode = 0;
+            bool encoding = false;              // An engine is pushing frames into the encoder
+            int frames_done = 0;
+
+            auto renderFrames = [&](OrbitRenderer& renderer) {
+                auto stopRequested = [&]() {
+                    return cancelled || failed || (work_queue && work_queue->shouldCancelCurrentJob());
+                };
+                while (!stopRequested()) {
+                    int i = next_frame++;
+                    if (i >= orbit_frames) {
+                        return;
+                    }
+
+                    dl::Vec2 angle{360.0 * i / orbit_frames, 0.0};
+                    renderer.orbit(dl::Vec2{angle.x - renderer.applied.x, angle.y - renderer.applied.y});
+                    renderer.applied = angle;
+
+                    renderer.signal->arm(true);
+                    renderer.engine->start();
+                    RenderSignal::Outcome outcome = renderer.signal->wait(*renderer.engine, stopRequested);
+                    if (outcome == RenderSignal::Outcome::Cancelled) {
+                        renderer.engine->stop();
+                        if (work_queue && work_queue->shouldCancelCurrentJob()) {
+                            cancelled = true;
+                        }
+                        return;
+                    }
+                    if (outcome == RenderSignal::Outcome::Failed) {
+                        std::cout << "❌ Bella render failed on frame " << (i + 1) << ": " << renderer.signal->lastError() << std::endl;
+                        failed = true;
+                        return;
+                    }
+
+                    RenderFrame frame;
+                    if (!renderer.signal->takeFrame(frame)) {
+                        std::cout << "❌ No image received for frame " << (i + 1) << std::endl;
+                        failed = true;
+                        return;
+                    }
+                    RenderSignal::Timing timing = renderer.signal->lastTiming();
+                    (renderer.frames == 0 ? renderer.first_setup_ms : renderer.later_setup_ms) += timing.setup_ms;
+                    renderer.sampling_ms += timing.sampling_ms;
+                    renderer.frames++;
+
+                    std::unique_lock<std::mutex> lock(frames_mutex);
+                    finished_frames.emplace(i, std::move(frame));
+                    frames_done++;
+
+                    // One engine at a time moves the in-order frames out and pushes them after
+                    // unlocking, so a blocked ffmpeg pipe never holds up another engine's hand-in.
+                    // Frames that arrive meanwhile are picked up by the same loop, keeping the order.
+                    if (!encoding) {
+                        encoding = true;
+                        std::vector<RenderFrame> ready;
+                        while (true) {
+                            for (auto next = finished_frames.find(next_to_encode); next != finished_frames.end(); 
+                                 next = finished_frames.find(next_to_encode)) {
+                                ready.push_back(std::move(next->second));
+                                finished_frames.erase(next);
+                                next_to_encode++;
+                            }
+                            if (ready.empty()) {
+                                break;
+                            }
+                            frames_drained.notify_all();
+                            lock.unlock();
+                            for (RenderFrame& readyFrame : ready) {
+                                if (!encoder.push(std::move(readyFrame.rgba), readyFrame.width, readyFrame.height)) {
+                                    failed = true;
+                                }
+                            }
+                            ready.clear();
+                            lock.lock();
+                        }
+                        encoding = false;
+                    }
+                    std::cout << "✅ Frame " << (i + 1) << " completed (" << frames_done << "/" << orbit_frames << ", setup " 
+                              << timing.setup_ms << " ms, sampling " << timing.sampling_ms << " ms)" << std::endl;
+                    if (status_board) {
+                        status_board->setStage(item_id, "🎨 Rendering `" + filename + "` frame " + std::to_string(frames_done) + "/" + std::to_string(orbit_frames));
+                    }
+
+                    // An engine that ran ahead of a slow one waits, so at most one out-of-order
+                    // frame per engine is held while the earlier frame is still rendering
+                    while (finished_frames.size() >= renderers.size() && !stopRequested()) {
+                        frames_drained.wait_for(lock, std::chrono::milliseconds(100));
+                    }
+                }
+            };
+
+            std::vector<std::thread> helper_threads;
+            for (size_t r = 1; r < renderers.size(); r++) {
+                helper_threads.emplace_back(renderFrames, std::ref(renderers[r]));
+            }
+            renderFrames(renderers[0]);
+            for (auto& thread : helper_threads) {
+                thread.join();
+            }
+            for (OrbitEngine* helper : orbitEngines) {
+                helper->releaseSnapshot();
+            }
+
+            if (cancelled || (work_queue && work_queue->shouldCancelCurrentJob())) {
+                std::cout << "🛑 Cancelling orbit render for job " << item_id << " after " << frames_done << " frames" << std::endl;
+                work_queue->markCurrentJobCancelled();
+                return "";
+            }
+            if (failed) {
+                return "";
+            }
+            // Later setup close to the first means each restart re-translates the scene
+            // Frames per second at a given orbit_side compare directly against an --orbitengines 1 run
+            double orbit_ms = elapsedMs(orbit_start);
+            std::cout << "⏱️ " << orbit_frames << " orbit frames in " << orbit_ms << " ms, " 
+                      << (orbit_ms > 0.0 ? orbit_frames * 1000.0 / orbit_ms : 0.0) << " frames/s at " << orbit_side << "px on " 
+                      << renderers.size() << " engine(s)" << std::endl;
+            for (size_t r = 0; r < renderers.size(); r++) {
+                const OrbitRenderer& renderer = renderers[r];
+                if (renderer.frames == 0) {
+                    continue;
+                }
+                std::cout << "   engine " << r << ": " << renderer.frames << " frames, first setup " << renderer.first_setup_ms 
+                          << " ms, later setup avg " << (renderer.frames > 1 ? renderer.later_setup_ms / (renderer.frames - 1) : 0.0) 
+                          << " ms, sampling avg " << renderer.sampling_ms / renderer.frames << " ms" << std::endl;
+            }
+            
+            std::cout << "🎬 All frames rendered, finishing MP4..." << std::endl;
+            if (status_board) {
+                status_board->setStage(item_id, "🎬 Encoding `" + filename + "` (" + std::to_string(orbit_frames) + " frames)");
+            }
+            
+            auto encode_start = std::chrono::steady_clock::now();
+            if (encoder.finish()) {
+                std::cout << "✅ MP4 conversion successful: " << output_mp4 << " (" 
+                          << elapsedMs(encode_start) << " ms after the last frame)" << std::endl;
+                
+                // Clean up temporary files
+                std::filesystem::remove_all(work_dir);
+                std::remove(temp_vmax_filename.c_str());
+                
+                return output_mp4;
+            } else {
+                std::cout << "❌ FFmpeg conversion failed" << std::endl;
+                return "";
+            }
+            
+        } else {
+            // Single frame rendering
+            std::cout << "🎨 Starting single frame bella render..." << std::endl;
+            if (status_board) {
+                status_board->setStage(item_id, "🎨 Rendering `" + filename + "`");
+            }
+            
+            // Wait for rendering to complete or the job to be cancelled
+            RenderSignal::Outcome outcome = renderAndWait();
+            
+            if (outcome == RenderSignal::Outcome::Cancelled) {
+                std::cout << "🛑 Cancelling bella render for job " << item_id << std::endl;
+                engine.stop();
+                std::cout << "🛑 Bella render cancelled successfully" << std::endl;
+                work_queue->markCurrentJobCancelled();
+                return "";
+            }
+            if (outcome == RenderSignal::Outcome::Failed) {
+                std::cout << "❌ Bella render failed for job " << item_id << ": " << renderSignal.lastError() << std::endl;
+                std::filesystem::remove_all(work_dir);
+                std::remove(temp_vmax_filename.c_str());
+                return "";
+            }
+            
+            std::cout << "✅ Single frame render completed!" << std::endl;
+            
+            // Clean up temporary files
+            std::filesystem::remove_all(work_dir);
+            std::remove(temp_vmax_filename.c_str());
+            
+            return output_dir + "/" + base_filename + ".jpg";
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Error processing .vmax.zip file: " << e.what() << std::endl;
+        
+        // Clean up temporary files
+        std::filesystem::remove_all(work_dir);
+        std::remove(temp_vmax_filename.c_str());
+        
+        return "";
+    }
+}
+
+/**
+ * Worker thread function that processes the work queue sequentially
+ */
+void workerThread(dpp::cluster* bot, WorkQueue* work_queue, dl::bella_sdk::Engine* engine, RenderSignal* renderSignal, const ConvertOptions* options, PaletteCache* paletteCache, JobStatusBoard* statusBoard, const std::vector<OrbitEngine*>* orbitEngines) {
+    std::cout << "🔧 Worker thread started" << std::endl;
+    
+    WorkItem item;
+    while (work_queue->dequeue(item)) {
+        std::cout << "\n--- PROCESSING VMAX FILE (Job " << item.id << ") ---" << std::endl;
+        std::cout << "Downloading: " << item.original_filename << std::endl;
+        std::cout << "From URL: " << item.attachment_url << std::endl;
+        
+        // Only admins may pick a better tier than the load governor
+        item.request.raise_quality = isAdminUser(item.user_id);
+
+        // Jobs recovered from the database after a restart get their status message here
+        statusBoard->track(item.id, item.channel_id, 0, "");
+        statusBoard->setStage(item.id, "📥 Downloading `" + item.original_filename + "`");
+        
+        // Download the .vmax.zip file using DPP's HTTP client
+        std::cout << "🌐 Starting .vmax.zip file download..." << std::endl;
+        
+        std::mutex download_mutex;
+        std::condition_variable download_cv;
+        bool download_complete = false;
+        bool download_success = false;
+        std::string download_data;
+        
+        bot->request(item.attachment_url, dpp::m_get, [&](const dpp::http_request_completion_t& response) {
+            std::lock_guard<std::mutex> lock(download_mutex);
+            
+            if (response.status == 200) {
+                std::cout << "✅ Downloaded .vmax.zip file (" << response.body.size() << " bytes)" << std::endl;
+                
+                // DEBUG: Add simple checksum to verify file content
+                std::hash<std::string> hasher;
+                size_t content_hash = hasher(response.body);
+                std::cout << "🔍 File content hash: " << std::hex << content_hash << std::dec << std::endl;
+                
+                download_data = response.body;
+                download_success = true;
+            } else {
+                std::cout << "❌ Failed to download .vmax.zip file. Status: " << response.status << std::endl;
+                download_success = false;
+            }
+            
+            download_complete = true;
+            download_cv.notify_one();
+        });
+        
+        // Wait for download to complete
+        {
+            std::unique_lock<std::mutex> lock(download_mutex);
+            download_cv.wait(lock, [&]{ return download_complete; });
+        }
+        
+        if (download_success) {
+            work_queue->setCurrentJobId(item.id);
+            statusBoard->setActive(item.id);
+            
+            std::vector<uint8_t> original_data(download_data.begin(), download_data.end());
+            
+            if (work_queue->shouldCancelCurrentJob()) {
+                std::cout << "🛑 Job " << item.id << " cancelled before processing" << std::endl;
+                work_queue->markCurrentJobCancelled();
+                statusBoard->setActive(0);
+                statusBoard->finish(item.id, "🛑 Cancelled `" + item.original_filename + "`");
+                removeJobScratch(item.id);
+                continue;
+            }
+            
+            // Posts the preview without waiting for Discord, the final render starts right away
+            auto sendPreview = [&](const std::string& preview_filename) {
+                std::ifstream preview_file(preview_filename, std::ios::binary);
+                if (!preview_file.is_open()) {
+                    std::cout << "⚠️ Could not read preview file: " << preview_filename << std::endl;
+                    return;
+                }
+                std::string preview_data((std::istreambuf_iterator<char>(preview_file)), std::istreambuf_iterator<char>());
+                preview_file.close();
+                std::remove(preview_filename.c_str());
+
+                dpp::message preview_msg(item.channel_id, "👀 Quick preview of `" + item.original_filename + "`, full render on the way");
+                preview_msg.add_file(std::filesystem::path(preview_filename).filename().string(), preview_data);
+                bot->message_create(preview_msg, [preview_filename](const dpp::confirmation_callback_t& callback) {
+                    if (callback.is_error()) {
+                        std::cout << "⚠️ Failed to send preview " << preview_filename << ": " << callback.get_error().message << std::endl;
+                    }
+                });
+            };
+            
+            // Process the .vmax.zip file
+            std::string output_filename = processVmaxFile(*engine, *renderSignal, *options, *paletteCache, original_data, item.original_filename, item.request, work_queue, statusBoard, sendPreview, *orbitEngines, item.id);
+            statusBoard->setActive(0);
+            
+            if (work_queue->shouldCancelCurrentJob() || output_filename.empty()) {
+                std::cout << "🛑 Job " << item.id << " was cancelled or failed during processing" << std::endl;
+                if (work_queue->shouldCancelCurrentJob()) {
+                    work_queue->markCurrentJobCancelled();
+                }
+                if (work_queue->getCurrentJobId() != item.id) {
+                    statusBoard->finish(item.id, "🛑 Cancelled `" + item.original_filename + "`");
+                } else {
+                    statusBoard->finish(item.id, "❌ Failed to render `" + item.original_filename + "`");
+                }
+                removeJobScratch(item.id);
+                continue;
+            }
+            statusBoard->setStage(item.id, "📤 Uploading `" + item.original_filename + "`");
+            
+            // Read and send the output file
+            std::vector<uint8_t> file_data;
+            dpp::message msg(item.channel_id, "");
+            
+            std::ifstream output_file(output_filename, std::ios::binary);
+            
+            if (output_file.is_open()) {
+                output_file.seekg(0, std::ios::end);
+                size_t file_size = output_file.tellg();
+                output_file.seekg(0, std::ios::beg);
+                
+                file_data.resize(file_size);
+                output_file.read(reinterpret_cast<char*>(file_data.data()), file_size);
+                output_file.close();
+                
+                std::cout << "📁 Read output file: " << output_filename << " (" << file_data.size() << " bytes)" << std::endl;
+                
+                bool is_mp4 = (output_filename.length() >= 4 && output_filename.substr(output_filename.length() - 4) == ".mp4");
+                
+                if (is_mp4) {
+                    msg.content = "🎬 Here's your VoxelMax orbit animation! <@" + std::to_string(item.user_id) + ">";
+                } else {
+                    msg.content = "🎨 Here's your rendered VoxelMax image! <@" + std::to_string(item.user_id) + ">";
+                }
+                std::string attachment_name = is_mp4 ? uploadBaseName(item.original_filename) + "_orbit.mp4" 
+                                                     : std::filesystem::path(output_filename).filename().string();
+                msg.add_file(attachment_name, std::string(file_data.begin(), file_data.end()));
+            } else {
+                std::cout << "❌ Could not read output file: " << output_filename << std::endl;
+                msg.content = "❌ Rendering completed but could not read output file. <@" + std::to_string(item.user_id) + ">";
+            }
+            
+            // Send the message
+            std::mutex send_mutex;
+            std::condition_variable send_cv;
+            bool send_complete = false;
+            bool send_success = false;
+            
+            bot->message_create(msg, [&](const dpp::confirmation_callback_t& callback) {
+                std::lock_guard<std::mutex> lock(send_mutex);
+                
+                if (callback.is_error()) {
+                    std::cout << "❌ Failed to send message: " << callback.get_error().message << std::endl;
+                    send_success = false;
+                } else {
+                    if (file_data.empty()) {
+                        std::cout << "✅ Successfully sent error message for " << item.original_filename << std::endl;
+                    } else {
+                        std::cout << "✅ Successfully sent " << output_filename << "!" << std::endl;
+                    }
+                    send_success = true;
+                }
+                
+                send_complete = true;
+                send_cv.notify_one();
+            });
+            
+            // Wait for send to complete
+            {
+                std::unique_lock<std::mutex> lock(send_mutex);
+                send_cv.wait(lock, [&]{ return send_complete; });
+            }
+            
+            if (send_success && !file_data.empty()) {
+                work_queue->markCompleted(item.id);
+                statusBoard->finish(item.id, "✅ Rendered `" + item.original_filename + "`");
+            } else {
+                work_queue->markFailed(item.id);
+                statusBoard->finish(item.id, "❌ Failed to deliver `" + item.original_filename + "`");
+            }
+            
+        } else {
+            // Download failed
+            statusBoard->finish(item.id, "❌ Failed to download `" + item.original_filename + "` for processing.");
+            work_queue->markFailed(item.id);
+        }
+        removeJobScratch(item.id);
+        
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+    
+    std::cout << "🔧 Worker thread shutting down" << std::endl;
+}
+
+struct MyEngineObserver : public dl::bella_sdk::EngineObserver
+{
+public:
+    // Called when a rendering pass starts
+    void onStarted(dl::String pass) override
+    {
+        dl::logInfo("Started pass %s", pass.buf());
+        std::lock_guard<std::mutex> lock(progressMutex);
+        current = RenderProgress{};
+        current.pass = pass.buf();
+        passStart = std::chrono::steady_clock::now();
+        lastPublish = std::chrono::steady_clock::time_point{};
+        nextLogPercent = 0.0;
+        loggedImage = false;
+    }
+
+    // Called to update the current status of rendering
+    void onStatus(dl::String pass, dl::String status) override
+    {
+        dl::logInfo("%s [%s]", status.buf(), pass.buf());
+    }
+
+    // Called to update rendering progress (percentage, time remaining, etc)
+    // Fires many times a second, so the row update is limited to once a second and
+    // the log line to every 10%
+    void onProgress(dl::String pass, dl::bella_sdk::Progress progress) override
+    {
+        RenderProgress snapshot;
+        bool publish = false;
+        bool log = false;
+        {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            auto now = std::chrono::steady_clock::now();
+            double fraction = std::min(1.0, std::max(0.0, static_cast<double>(progress.progress())));
+            current.pass = pass.buf();
+            current.percent = fraction * 100.0;
+            if (fraction > 0.01) {
+                double elapsedSeconds = std::chrono::duration<double>(now - passStart).count();
+                current.eta_seconds = static_cast<int64_t>(elapsedSeconds * (1.0 - fraction) / fraction);
+            }
+            snapshot = current;
+
+            publish = now - lastPublish >= std::chrono::seconds(1) || fraction >= 1.0;
+            if (publish) {
+                lastPublish = now;
+            }
+            log = current.percent >= nextLogPercent;
+            if (log) {
+                nextLogPercent = (static_cast<int>(current.percent / 10.0) + 1) * 10.0;
+            }
+        }
+        if (log) {
+            dl::logInfo("%s [%s]", progress.toString().buf(), pass.buf());
+        }
+        if (publish && workQueue) {
+            workQueue->updateCurrentJobProgress(snapshot);
+        }
+        if (statusBoard) {
+            statusBoard->setActiveProgress(snapshot.percent);
+        }
+        if (renderSignal) {
+            renderSignal->notifySampling();
+        }
+    }
+
+    void onImage(dl::String pass, dl::bella_sdk::Image image) override
+    {
+        std::lock_guard<std::mutex> lock(progressMutex);
+        if (!loggedImage) {
+            dl::logInfo("We got an image %d x %d.", (int)image.width(), (int)image.height());
+            loggedImage = true;
+        }
+        if (renderSignal) {
+            renderSignal->storeFrame(image);
+        }
+    }  
+
+    // Called when an error occurs during rendering
+    void onError(dl::String pass, dl::String msg) override
+    {
+        dl::logError("%s [%s]", msg.buf(), pass.buf());
+        if (renderSignal) {
+            renderSignal->notifyError(msg.buf());
+        }
+    }
+
+    // Called when a rendering pass completes
+    void onStopped(dl::String pass) override
+    {
+        dl::logInfo("Stopped %s", pass.buf());
+        if (renderSignal) {
+            renderSignal->notifyStopped();
+        }
+    }
+
+    // Render stop and error callbacks are forwarded to this signal
+    void setRenderSignal(RenderSignal* signal) {
+        renderSignal = signal;
+    }
+
+    // Sampled progress is also written to the current job's row
+    void setWorkQueue(WorkQueue* queue) {
+        workQueue = queue;
+    }
+
+    // Progress of every callback goes to the board, which decides when Discord sees it
+    void setStatusBoard(JobStatusBoard* board) {
+        statusBoard = board;
+    }
+
+    // Returns the latest progress of the running pass
+    RenderProgress getProgress() const {
+        std::lock_guard<std::mutex> lock(progressMutex);
+        return current;
+    }
+
+private:
+    mutable std::mutex progressMutex;
+    RenderProgress current;
+    std::chrono::steady_clock::time_point passStart;
+    std::chrono::steady_clock::time_point lastPublish;
+    double nextLogPercent = 0.0;
+    bool loggedImage = false;
+    RenderSignal* renderSignal = nullptr;
+    WorkQueue* workQueue = nullptr;
+    JobStatusBoard* statusBoard = nullptr;
+};
+
+
+
+//==============================================================================
+// BENCHMARKS
+//==============================================================================
+
+/**
+ * Renders the current scene at 160x160 and returns wall time in milliseconds
+ */
+double timeBenchmarkRender(dl::bella_sdk::Engine& engine) {
+    auto belScene = engine.scene();
+    belScene.camera()["resolution"] = dl::Vec2{160, 160};
+    belScene.beautyPass()["saveImage"] = dl::Int(0);
+
+    auto start = std::chrono::steady_clock::now();
+    engine.start();
+    while (engine.rendering()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return elapsedMs(start);
+}
+
+/**
+ * Builds the synthetic model into a fresh default scene with the given options, then renders it
+ */
+void benchmarkLayout(dl::bella_sdk::Engine& engine, 
+                     const char* label, 
+                     const ConvertOptions& options, 
+                     const oom::vmax::Model& benchModel) {
+    JobScene belJob(engine.scene(), "vmaxBenchmark");
+    auto belScene = belJob.scene;
+    dl::bella_sdk::Node belWorld = belJob.root;
+
+    DecodedPalette benchPalette = makeDecodedPalette(std::vector<oom::vmax::RGBA>(256, oom::vmax::RGBA{200, 200, 200, 255}), {});
+    SceneBuildStats buildStats;
+
+    auto start = std::chrono::steady_clock::now();
+    dl::bella_sdk::Node belModel = addModelToScene(options, belJob, belWorld, benchModel, benchPalette, &buildStats);
+    belModel.parentTo(belWorld);
+    double buildMs = elapsedMs(start);
+
+    dl::bella_sdk::zoomExtents(belScene.cameraPath(), dl::Vec3{128.0, 128.0, 76.5}, 200.0);
+    double renderMs = timeBenchmarkRender(engine);
+
+    std::cout << "⏱️ [" << label << "] addModelToScene: " << buildMs << " ms, render: " << renderMs << " ms (" 
+              << buildStats.instance_count << " instances in " 
+              << buildStats.instancer_count << " instancers, " 
+              << buildStats.mesh_quads << " quads)" << std::endl;
+}
+
+/**
+ * Places instanceCount xforms of one small canonical model, 100 per group, the way
+ * processVmaxFile does, with or without a surrounding EventScope
+ */
+void benchmarkInstances(dl::bella_sdk::Engine& engine, 
+                        const ConvertOptions& options, 
+                        int instanceCount, 
+                        bool batched) {
+    JobScene belJob(engine.scene(), batched ? "vmaxBenchmarkBatched" : "vmaxBenchmarkUnbatched");
+    dl::bella_sdk::Node belWorld = belJob.root;
+
+    oom::vmax::Model cubeModel("benchmarkCube.vmaxb");
+    for (int i = 0; i < 8; i++) {
+        cubeModel.addVoxel(i & 1, (i >> 1) & 1, (i >> 2) & 1, 0, 1, 0, 0);
+    }
+    DecodedPalette benchPalette = makeDecodedPalette(std::vector<oom::vmax::RGBA>(256, oom::vmax::RGBA{200, 200, 200, 255}), {});
+
+    auto start = std::chrono::steady_clock::now();
+    belJob.reserve(static_cast<size_t>(instanceCount) * 2);
+    std::optional<dl::bella_sdk::Scene::EventScope> sceneEvents;
+    if (batched) {
+        sceneEvents.emplace(belJob.scene);
+    }
+    dl::bella_sdk::Node belCube = addModelToScene(options, belJob, belWorld, cubeModel, benchPalette);
+    dl::bella_sdk::Node belGroup;
+    for (int i = 0; i < instanceCount; i++) {
+        if (i % 100 == 0) {
+            belGroup = belJob.createNode("xform", dl::String::format("_benchGroup%d", i / 100));
+            belGroup["steps"][0]["xform"] = dl::Mat4 {1,0,0,0, 0,1,0,0, 0,0,1,0, 0, 0, static_cast<double>(i / 100) * 3.0, 1};
+            belGroup.parentTo(belWorld);
+        }
+        auto belInstance = belJob.createNode("xform", dl::String::format("_benchInstance%d", i));
+        belInstance["steps"][0]["xform"] = dl::Mat4 {1,0,0,0, 0,1,0,0, 0,0,1,0, static_cast<double>(i % 100) * 3.0, 0, 0, 1};
+        belInstance.parentTo(belGroup);
+        belCube.parentTo(belInstance);
+    }
+    sceneEvents.reset();
+
+    std::cout << "⏱️ [" << (batched ? "batched" : "unbatched") << "] " << instanceCount 
+              << " instances placed in " << elapsedMs(start) << " ms" << std::endl;
+}
+
+/**
+ * Synthetic deep hierarchy: 10 group chains of the given depth, 100 instances of a small
+ * model under each leaf group. Times translation and the first 160x160 render with the
+ * chains kept as nested xforms or flattened into the instance matrices
+ */
+void benchmarkHierarchy(dl::bella_sdk::Engine& engine, 
+                        const ConvertOptions& options, 
+                        int depth, 
+                        bool flatten) {
+    JobScene belJob(engine.scene(), flatten ? "vmaxBenchmarkFlat" : "vmaxBenchmarkNested");
+    dl::bella_sdk::Node belWorld = belJob.root;
+
+    std::map<std::string, oom::vmax::JsonGroupInfo> jsonGroups;
+    std::vector<std::string> leafGroups;
+    for (int chain = 0; chain < 10; chain++) {
+        std::string parentId;
+        for (int level = 0; level < depth; level++) {
+            oom::vmax::JsonGroupInfo groupInfo;
+            groupInfo.id = "bench-" + std::to_string(chain) + "-" + std::to_string(level);
+            groupInfo.parentId = parentId;
+            groupInfo.rotation = {0.0, 0.0, 0.0, 1.0};
+            groupInfo.position = {level == 0 ? chain * 24.0 : 0.0, 0.0, 1.0};
+            groupInfo.scale = {1.0, 1.0, 1.0};
+            jsonGroups[groupInfo.id] = groupInfo;
+            parentId = groupInfo.id;
+        }
+        leafGroups.push_back(parentId);
+    }
+
+    oom::vmax::Model cubeModel("benchmarkCube.vmaxb");
+    for (int i = 0; i < 8; i++) {
+        cubeModel.addVoxel(i & 1, (i >> 1) & 1, (i >> 2) & 1, 0, 1, 0, 0);
+    }
+    DecodedPalette benchPalette = makeDecodedPalette(std::vector<oom::vmax::RGBA>(256, oom::vmax::RGBA{200, 200, 200, 255}), {});
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        dl::bella_sdk::Scene::EventScope es(belJob.scene);
+        dl::bella_sdk::Node belCube = addModelToScene(options, belJob, belWorld, cubeModel, benchPalette);
+        std::map<std::string, oom::vmax::Matrix4x4> groupWorld = groupWorldMatrices(jsonGroups, acyclicGroupParents(jsonGroups));
+
+        std::map<std::string, dl::bella_sdk::Node> belGroups;
+        if (!flatten) {
+            for (const auto& [groupId, groupInfo] : jsonGroups) {
+                oom::vmax::Matrix4x4 local = oom::vmax::combineTransforms(groupInfo.rotation[0], groupInfo.rotation[1], groupInfo.rotation[2], groupInfo.rotation[3],
+                                                                          groupInfo.position[0], groupInfo.position[1], groupInfo.position[2], 
+                                                                          groupInfo.scale[0], groupInfo.scale[1], groupInfo.scale[2]);
+                auto belGroup = belJob.createNode("xform", belNodeId(groupId));
+                belGroup["steps"][0]["xform"] = dl::Mat4({
+                    local.m[0][0], local.m[0][1], local.m[0][2], local.m[0][3],
+                    local.m[1][0], local.m[1][1], local.m[1][2], local.m[1][3],
+                    local.m[2][0], local.m[2][1], local.m[2][2], local.m[2][3],
+                    local.m[3][0], local.m[3][1], local.m[3][2], local.m[3][3]
+                    });
+                belGroups[groupId] = belGroup;
+            }
+            for (const auto& [groupId, groupInfo] : jsonGroups) {
+                belGroups[groupId].parentTo(groupInfo.parentId.empty() ? belWorld : belGroups[groupInfo.parentId]);
+            }
+        }
+
+        for (size_t chain = 0; chain < leafGroups.size(); chain++) {
+            for (int i = 0; i < 100; i++) {
+                oom::vmax::Matrix4x4 objectMat4 = oom::vmax::combineTransforms(0.0, 0.0, 0.0, 1.0, 
+                                                                               (i % 10) * 2.0, (i / 10) * 2.0, 0.0, 
+                                                                               1.0, 1.0, 1.0);
+                if (flatten) {
+                    objectMat4 = multiplyMatrices(objectMat4, groupWorld[leafGroups[chain]]);
+                }
+                auto belInstance = belJob.createNode("xform", dl::String::format("_benchInstance%d", static_cast<int>(chain * 100 + i)));
+                belInstance["steps"][0]["xform"] = dl::Mat4({
+                    objectMat4.m[0][0], objectMat4.m[0][1], objectMat4.m[0][2], objectMat4.m[0][3],
+                    objectMat4.m[1][0], objectMat4.m[1][1], objectMat4.m[1][2], objectMat4.m[1][3],
+                    objectMat4.m[2][0], objectMat4.m[2][1], objectMat4.m[2][2], objectMat4.m[2][3],
+                    objectMat4.m[3][0], objectMat4.m[3][1], objectMat4.m[3][2], objectMat4.m[3][3]
+                    });
+                belInstance.parentTo(flatten ? belWorld : belGroups[leafGroups[chain]]);
+                belCube.parentTo(belInstance);
+            }
+        }
+    }
+    double buildMs = elapsedMs(start);
+
+    dl::bella_sdk::zoomExtents(belJob.scene.cameraPath(), dl::Vec3{120.0, 10.0, static_cast<double>(depth)}, 140.0);
+    double renderMs = timeBenchmarkRender(engine);
+
+    std::cout << "⏱️ [" << (flatten ? "flattened" : "nested") << " depth " << depth << "] 1000 instances, " 
+              << belJob.nodeCount() << " job nodes, translation: " << buildMs << " ms, render: " << renderMs << " ms" << std::endl;
+}
+
+/**
+ * Adds the 128x128x64 voxel block the orbit benchmarks render, framed by a 160px camera
+ * Returns the xform the block hangs under, which benchmarkOrbit may move per frame
+ */
+dl::bella_sdk::Node addBenchmarkOrbitBlock(const ConvertOptions& options, JobScene& belJob) {
+    dl::bella_sdk::Node belWorld = belJob.root;
+
+    oom::vmax::Model blockModel("benchmarkOrbit.vmaxb");
+    for (int z = 0; z < 64; z++) {
+        for (int y = 0; y < 128; y++) {
+            for (int x = 0; x < 128; x++) {
+                blockModel.addVoxel(x, y, z, 0, 1 + ((x / 16 + y / 16) & 3), 0, 0);
+            }
+        }
+    }
+    DecodedPalette benchPalette = makeDecodedPalette(std::vector<oom::vmax::RGBA>(256, oom::vmax::RGBA{200, 200, 200, 255}), {});
+    dl::bella_sdk::Node belInstance;
+    {
+        dl::bella_sdk::Scene::EventScope es(belJob.scene);
+        dl::bella_sdk::Node belBlock = addModelToScene(options, belJob, belWorld, blockModel, benchPalette);
+        belInstance = belJob.createNode("xform", "_benchOrbitInstance");
+        belInstance["steps"][0]["xform"] = dl::Mat4 {1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1};
+        belInstance.parentTo(belWorld);
+        belBlock.parentTo(belInstance);
+    }
+    dl::bella_sdk::zoomExtents(belJob.scene.cameraPath(), dl::Vec3{64.0, 64.0, 32.0}, 100.0);
+    belJob.scene.camera()["resolution"] = dl::Vec2{160, 160};
+    belJob.scene.beautyPass()["saveImage"] = dl::Int(0);
+    return belInstance;
+}
+
+/**
+ * Renders the benchmark block as orbit frames and splits each frame into setup and
+ * sampling time. With cameraOnly false an instance xform is also rewritten every frame;
+ * comparing its setup times against the camera-only run shows whether a restart after a
+ * camera-only edit costs any less than one after a scene edit.
+ */
+void benchmarkOrbit(dl::bella_sdk::Engine& engine, 
+                    RenderSignal& renderSignal, 
+                    const ConvertOptions& options, 
+                    bool cameraOnly) {
+    JobScene belJob(engine.scene(), cameraOnly ? "vmaxBenchmarkOrbitCamera" : "vmaxBenchmarkOrbitScene");
+    dl::bella_sdk::Node belInstance = addBenchmarkOrbitBlock(options, belJob);
+
+    const int frames = 6;
+    double firstSetup = 0.0, laterSetup = 0.0, sampling = 0.0;
+    for (int i = 0; i < frames; i++) {
+        {
+            dl::bella_sdk::Scene::EventScope frameEvents(belJob.scene);
+            belJob.orbitCamera(dl::Vec2{360.0 / frames, 0.0});
+            if (!cameraOnly) {
+                belInstance["steps"][0]["xform"] = dl::Mat4 {1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,i * 1.0e-3,1};
+            }
+        }
+        renderSignal.arm();
+        engine.start();
+        renderSignal.wait(engine, []() { return false; });
+        RenderSignal::Timing timing = renderSignal.lastTiming();
+        (i == 0 ? firstSetup : laterSetup) += timing.setup_ms;
+        sampling += timing.sampling_ms;
+    }
+
+    std::cout << "⏱️ [orbit " << (cameraOnly ? "camera only" : "camera + xform") << "] " << frames 
+              << " frames, first setup " << firstSetup << " ms, later setup avg " << laterSetup / (frames - 1) 
+              << " ms, sampling avg " << sampling / frames << " ms" << std::endl;
+}
+
+/**
+ * Renders the same 24 orbit frames of the benchmark block on the main engine alone with
+ * every core, then on the main engine plus the --orbitengines helpers with the cores split
+ * the way processVmaxFile splits them, and logs frames/s of both runs. Linear scaling would
+ * make the second run as many times faster as there are engines.
+ */
+void benchmarkOrbitEngines(dl::bella_sdk::Engine& engine, 
+                           RenderSignal& renderSignal, 
+                           const ConvertOptions& options, 
+                           const std::vector<OrbitEngine*>& orbitEngines) {
+    if (orbitEngines.empty()) {
+        std::cout << "⏱️ [orbit engines] skipped, run with --orbitengines 2 or more to compare" << std::endl;
+        return;
+    }
+    JobScene belJob(engine.scene(), "vmaxBenchmarkOrbitEngines");
+    addBenchmarkOrbitBlock(options, belJob);
+
+    struct BenchRenderer {
+        dl::bella_sdk::Engine* engine;
+        RenderSignal* signal;
+        std::function<void(const dl::Vec2&)> orbit;
+        dl::Vec2 applied{0.0, 0.0};
+    };
+    const int frames = 24;
+
+    // Same absolute 360*i/N angles as the job path, so either run renders identical frames
+    auto renderOrbit = [&](std::vector<BenchRenderer>& renderers) {
+        auto start = std::chrono::steady_clock::now();
+        std::atomic<int> next_frame{0};
+        auto renderFrames = [&](BenchRenderer& renderer) {
+            for (int i = next_frame++; i < frames; i = next_frame++) {
+                dl::Vec2 angle{360.0 * i / frames, 0.0};
+                renderer.orbit(dl::Vec2{angle.x - renderer.applied.x, angle.y - renderer.applied.y});
+                renderer.applied = angle;
+                renderer.signal->arm();
+                renderer.engine->start();
+                renderer.signal->wait(*renderer.engine, []() { return false; });
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t r = 1; r < renderers.size(); r++) {
+            threads.emplace_back(renderFrames, std::ref(renderers[r]));
+        }
+        renderFrames(renderers[0]);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        // Back to the pose the orbit started in, ready for the next run
+        for (BenchRenderer& renderer : renderers) {
+            renderer.orbit(dl::Vec2{-renderer.applied.x, -renderer.applied.y});
+            renderer.applied = dl::Vec2{0.0, 0.0};
+        }
+        return elapsedMs(start);
+    };
+    auto mainOrbit = [&belJob](const dl::Vec2& offset) {
+        dl::bella_sdk::Scene::EventScope cameraEvents(belJob.scene);
+        belJob.orbitCamera(offset);
+    };
+
+    std::vector<BenchRenderer> single = {{&engine, &renderSignal, mainOrbit}};
+    double singleMs = renderOrbit(single);
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    int threadsPerEngine = std::max(1, static_cast<int>(cores / (orbitEngines.size() + 1)));
+    belJob.setRenderThreads(threadsPerEngine);
+
+    std::string benchDir = scratchRoot() + "/benchmark";
+    std::string orbitBsz = benchDir + "/orbit.bsz";
+    std::error_code ec;
+    std::filesystem::create_directories(benchDir, ec);
+    std::vector<BenchRenderer> split = {{&engine, &renderSignal, mainOrbit}};
+    if (belJob.scene.write(orbitBsz.c_str())) {
+        for (OrbitEngine* helper : orbitEngines) {
+            if (!helper->loadSnapshot(orbitBsz)) {
+                std::cout << "⚠️ Orbit engine could not load " << orbitBsz << std::endl;
+                continue;
+            }
+            auto helperScene = helper->engine.scene();
+            split.push_back({&helper->engine, &helper->signal, [helperScene](const dl::Vec2& offset) mutable {
+                dl::bella_sdk::Scene::EventScope cameraEvents(helperScene);
+                dl::bella_sdk::orbitCamera(helperScene.cameraPath(), offset);
+            }});
+        }
+    }
+    double splitMs = renderOrbit(split);
+    for (OrbitEngine* helper : orbitEngines) {
+        helper->releaseSnapshot();
+    }
+    belJob.restoreRenderSettings();
+    std::filesystem::remove_all(benchDir, ec);
+
+    double singleFps = singleMs > 0.0 ? frames * 1000.0 / singleMs : 0.0;
+    double splitFps = splitMs > 0.0 ? frames * 1000.0 / splitMs : 0.0;
+    std::cout << "⏱️ [orbit engines] " << frames << " frames at 160px, 1 engine x " << cores << " threads: " 
+              << singleFps << " frames/s, " << split.size() << " engines x " << threadsPerEngine << " threads: " 
+              << splitFps << " frames/s, speedup " << (singleFps > 0.0 ? splitFps / singleFps : 0.0) 
+              << " (linear " << split.size() << ")" << std::endl;
+}
+
+/**
+ * Scene build micro-benchmark on one synthetic 10M voxel bucket (256x256x153 solid block)
+ * Compares one-at-a-time push_back against the pre-sized parallel fill, then builds and
+ * renders the bucket as a single instancer and as per-chunk instancers, on top of the
+ * current command line flags. Finishes with instance placement timings at 1k and 10k
+ * instances, batched and unbatched, and 100k batched, then nested vs flattened group
+ * hierarchies of depth 4 and 32, orbit frame setup with and without scene edits, and
+ * orbit frames/s on one engine against the --orbitengines split
+ */
+int runSceneBuildBenchmark(dl::bella_sdk::Engine& engine, 
+                           RenderSignal& renderSignal, 
+                           const ConvertOptions& options, 
+                           const std::vector<OrbitEngine*>& orbitEngines) {
+    std::cout << "⏱️ Scene build benchmark: 10M voxel bucket, " 
+              << std::max(1u, std::thread::hardware_concurrency()) << " worker threads" << std::endl;
+
+    oom::vmax::Model benchModel("benchmark.vmaxb");
+    for (int z = 0; z < 153; z++) {
+        for (int y = 0; y < 256; y++) {
+            for (int x = 0; x < 256; x++) {
+                benchModel.addVoxel(x, y, z, 0, 1, 0, 0);
+            }
+        }
+    }
+    const std::vector<oom::vmax::Voxel>& voxels = benchModel.getVoxels(0, 1);
+    std::cout << "📦 Voxels: " << voxels.size() << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    dl::ds::Vector<dl::Mat4f> serialArray;
+    for (const auto& eachvoxel : voxels) {
+        serialArray.push_back( dl::Mat4f{  1, 0, 0, 0, 
+                                        0, 1, 0, 0, 
+                                        0, 0, 1, 0, 
+                                        (static_cast<float>(eachvoxel.x))+0.5f,
+                                        (static_cast<float>(eachvoxel.y))+0.5f,
+                                        (static_cast<float>(eachvoxel.z))+0.5f, 1 });
+    }
+    std::cout << "⏱️ push_back fill: " << elapsedMs(start) << " ms" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    dl::ds::Vector<dl::Mat4f> parallelArray;
+    fillVoxelInstances(voxels, parallelArray);
+    std::cout << "⏱️ pre-sized parallel fill: " << elapsedMs(start) << " ms" << std::endl;
+
+    ConvertOptions singleOptions = options;
+    singleOptions.chunk_instancers = false;
+    benchmarkLayout(engine, "single instancer", singleOptions, benchModel);
+
+    ConvertOptions chunkedOptions = options;
+    chunkedOptions.chunk_instancers = true;
+    benchmarkLayout(engine, "chunked instancers", chunkedOptions, benchModel);
+
+    for (int instanceCount : {1000, 10000}) {
+        benchmarkInstances(engine, options, instanceCount, false);
+        benchmarkInstances(engine, options, instanceCount, true);
+    }
+    benchmarkInstances(engine, options, 100000, true);
+
+    for (int depth : {4, 32}) {
+        benchmarkHierarchy(engine, options, depth, false);
+        benchmarkHierarchy(engine, options, depth, true);
+    }
+
+    benchmarkOrbit(engine, renderSignal, options, true);
+    benchmarkOrbit(engine, renderSignal, options, false);
+    benchmarkOrbitEngines(engine, renderSignal, options, orbitEngines);
+    return 0;
+}
+
+//==============================================================================
+// MAIN FUNCTION - Discord bot entry point
+//==============================================================================
+
+int DL_main(dl::Args& args) {
+    // Fix locale issues early
+    try {
+        std::locale::global(std::locale("C"));
+        setenv("LC_ALL", "C", 1);
+        setenv("LANG", "C", 1);
+        std::cout << "✅ Set system locale to 'C' for compatibility" << std::endl;
+    } catch (const std::exception& e) {
+        std::cout << "⚠️ Could not set initial locale: " << e.what() << std::endl;
+    }
+
+#ifndef _WIN32
+    // A crashed ffmpeg must fail the encoder's write, not kill the bot
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    // Setup Bella logging callbacks
+    int s_oomBellaLogContext = 0; 
+    dl::subscribeLog(&s_oomBellaLogContext, oom::bella::log);
+    dl::flushStartupMessages();
+
+    // Add command line arguments
+    args.add("tp", "thirdparty",    "",   "prints third party licenses");
+    args.add("li", "licenseinfo",   "",   "prints license info");
+    args.add("t",  "token",         "",   "Discord bot token");
+    args.add("gb", "greedybox",     "",   "merge runs of same colored voxels into scaled box instances");
+    args.add("m",  "mode",          "",   "voxel output: box (default), mesh or auto (per bucket cost model)");
+    args.add("cm", "costmodel",     "",   "auto mode weights as instance,quad,mesh (default 64,28,4096)");
+    args.add("ci", "chunkinstancers", "", "split voxel instancers along VoxelMax chunk boundaries");
+    args.add("dc", "dedupchunks",   "",   "share identical VoxelMax chunks through one instanced chunk node");
+    args.add("bv", "bevel",         "",   "bevel voxel edges");
+    args.add("fg", "flattengroups", "",   "bake scene.json group transforms into instances parented to world");
+    args.add("mc", "modelcache",    "",   "directory for decoded model cache, reused across uploads");
+    args.add("ms", "modelcachesize", "",  "model cache size limit in MB, least recently used entries are evicted (default 1024)");
+    args.add("dd", "debugdir",      "",   "save each job's debug .bsz (and .vmaxscene) to this directory as job<ID>");
+    args.add("im", "intermediate",  "",   "copy each job's .vmaxscene hand-off file to the debug directory (default vmax_debug)");
+    args.add("fq", "fixedquality",  "",   "render every job at the template quality regardless of queue depth");
+    args.add("qf", "qualityfloor",  "",   "adaptive quality limits as resolution,noise,seconds,frameseconds (default 320,25,20,2)");
+    args.add("oe", "orbitengines",  "",   "number of Bella engines rendering orbit frames in parallel (default 1)");
+    args.add("pv", "preview",       "",   "longest side of the quick preview sent before the final render, 0 disables (default 160)");
+    args.add("in", "inspect",       "",   "print the contents of a .vmaxscene file and exit");
+    args.add("bm", "benchmark",     "",   "run the scene build benchmark and exit");
+
+    if (args.helpRequested()) {
+        std::cout << args.help("poomer-discord-vmax (C) 2025 Harvey Fong","", "1.0") << std::endl;
+        return 0;
+    }
+    
+    if (args.have("--licenseinfo")) {
+        std::cout << "poomer-discord-vmax (C) 2025 Harvey Fong" << std::endl;
+        std::cout << oom::license::printLicense() << std::endl;
+        return 0;
+    }
+ 
+    if (args.have("--thirdparty")) {
+        std::cout << oom::license::printBellaSDK() << "\n====\n" << std::endl;
+        std::cout << oom::license::printLZFSE() << "\n====\n" << std::endl;
+        std::cout << oom::license::printLibPlist() << "\n====\n" << std::endl;
+        std::cout << oom::license::printOpenGameTools() << "\n====\n" << std::endl;
+        return 0;
+    }
+
+    if (args.have("--inspect")) {
+        return inspectSceneIntermediate(args.value("--inspect").buf());
+    }
+
+    // Initialize Bella Engine
+    std::cout << "=== Discord VoxelMax Bot Startup ===" << std::endl;
+    std::cout << "🎨 Initializing Bella Engine..." << std::endl;
+    
+    dl::bella_sdk::Engine engine;
+    engine.scene().loadDefs();
+    buildTemplateScene(engine);
+   
+    
+
+
+    //oom::bella::MyEngineObserver engineObserver;
+    RenderSignal renderSignal;
+    MyEngineObserver engineObserver;
+    engineObserver.setRenderSignal(&renderSignal);
+    engine.subscribe(&engineObserver);
+    
+    std::cout << "✅ Bella Engine initialized" << std::endl;
+
+    ConvertOptions convertOptions = convertOptionsFromArgs(args);
+
+    // Orbit frames are shared between the main engine and these
+    std::vector<std::unique_ptr<OrbitEngine>> orbitEngines;
+    std::vector<OrbitEngine*> orbitEngineList;
+    if (args.have("--orbitengines")) {
+        int engineCount = std::max(1, std::atoi(args.value("--orbitengines").buf()));
+        for (int i = 1; i < engineCount; i++) {
+            orbitEngines.push_back(std::make_unique<OrbitEngine>());
+            orbitEngineList.push_back(orbitEngines.back().get());
+        }
+        std::cout << "✅ " << engineCount << " engines for orbit frames" << std::endl;
+    }
+
+    if (args.have("--benchmark")) {
+        return runSceneBuildBenchmark(engine, renderSignal, convertOptions, orbitEngineList);
+    }
+
+    // Initialize work queue database
+    std::cout << "🗄️ Initializing work queue database..." << std::endl;
+    
+    WorkQueue work_queue;
+    work_queue.setRenderSignal(&renderSignal);
+    engineObserver.setWorkQueue(&work_queue);
+    if (!work_queue.initialize()) {
+        std::cerr << "❌ Failed to initialize work queue database" << std::endl;
+        return 1;
+    }
+    
+    // Get Discord bot token
+    std::string BOT_TOKEN;
+    if (args.have("--token")) {
+        BOT_TOKEN = args.value("--token").buf();
+        std::cout << "✅ Using token from command line" << std::endl;
+    } else {
+        BOT_TOKEN = getHiddenInput("Enter Discord Bot Token: ");
+    }
+    
+    if (BOT_TOKEN.empty()) {
+        std::cerr << "Error: Bot token cannot be empty!" << std::endl;
+        return 1;
+    }
+
+    // Create Discord bot instance
+	dpp::cluster bot(BOT_TOKEN, dpp::i_default_intents | dpp::i_message_content);
+
+    // Enable logging
+    bot.on_log(dpp::utility::cout_logger());
+    
+    // Start worker thread
+    sweepJobScratch();
+    std::cout << "🔧 Starting worker thread..." << std::endl;
+    PaletteCache paletteCache;
+    JobStatusBoard statusBoard(&bot);
+    engineObserver.setStatusBoard(&statusBoard);
+    std::thread worker(workerThread, &bot, &work_queue, &engine, &renderSignal, &convertOptions, &paletteCache, &statusBoard, &orbitEngineList);
+
+    // Set up event handler for file uploads
+    dl::Vec2 templateResolution = engine.scene().camera()["resolution"].asVec2();
+    int templateSide = static_cast<int>(std::max(templateResolution.x, templateResolution.y));
+    bot.on_message_create([&work_queue, &statusBoard, templateSide](const dpp::message_create_t& event) {
+        
+        if (event.msg.author.is_bot()) {
+            return;
+        }
+        
         if (!event.msg.attachments.empty()) {
             std::cout << "\n=== FILE UPLOAD DETECTED ===" << std::endl;
             std::cout << "User: " << event.msg.author.username << std::endl;
@@ -1495,7 +4432,20 @@ int DL_main(dl::Args& args) {
             if (found_vmax) {
                 std::cout << "\n🎯 ACTION: Enqueueing .vmax.zip files for processing" << std::endl;
                 
-                event.reply("🎮 VoxelMax file(s) detected! Adding to render queue...");
+                // Options are parsed and limited once, every attachment of the message shares them
+                std::vector<std::string> warnings;
+                RenderRequest request = parseRenderRequest(event.msg.content, warnings);
+                applyRenderLimits(request, renderLimitsForUser(event.msg.author.id), templateSide, warnings);
+                std::cout << "🎛️ Render options: " << (request.summary().empty() ? "defaults" : request.summary()) 
+                          << " (cost " << request.cost << ")" << std::endl;
+                if (!warnings.empty()) {
+                    std::string notice = "⚠️ Render options adjusted:";
+                    for (const auto& warning : warnings) {
+                        notice += "\n• " + warning;
+                    }
+                    event.reply(notice);
+                }
+                std::string options_text = request.summary().empty() ? "" : " (" + request.summary() + ")";
                 
                 for (const auto& vmax_attachment : vmax_attachments) {
                     WorkItem item;
@@ -1505,13 +4455,20 @@ int DL_main(dl::Args& args) {
                     item.user_id = event.msg.author.id;
                     item.username = event.msg.author.username;
                     item.message_content = event.msg.content;
+                    item.request = request;
                     item.created_at = std::time(nullptr);
                     item.retry_count = 0;
                     
-                    if (work_queue.enqueue(item)) {
+                    // Tracked before the row is visible, so the worker never claims the status message first
+                    std::string queued_text = "⏳ Queued `" + item.original_filename + "`" + options_text;
+                    auto track_queued = [&statusBoard, &item, &event, &queued_text](int64_t job_id) {
+                        statusBoard.track(job_id, item.channel_id, event.msg.id, queued_text);
+                    };
+                    if (work_queue.enqueue(item, nullptr, track_queued)) {
                         std::cout << "✅ Enqueued: " << vmax_attachment.filename << std::endl;
                     } else {
                         std::cout << "❌ Failed to enqueue: " << vmax_attachment.filename << std::endl;
+                        event.reply("❌ Could not add `" + vmax_attachment.filename + "` to the render queue.");
                     }
                 }
             }
@@ -1519,344 +4476,1589 @@ int DL_main(dl::Args& args) {
         }
     });
 
-    // Set up slash command handler
-    bot.on_slashcommand([&bot, &work_queue](const dpp::slashcommand_t& event) {
-        static int command_counter = 0;
-        int command_id = ++command_counter;
-        
-        std::cout << "\n=== COMMAND RECEIVED #" << command_id << " ===" << std::endl;
-        std::cout << "Command: " << event.command.get_command_name() << std::endl;
-        std::cout << "User: " << event.command.get_issuing_user().username << std::endl;
-        
-        if (event.command.get_command_name() == "help") {
-            std::string help_message = "🎮 I am a VoxelMax render bot! Drop .vmax.zip files and I'll convert them to beautiful images!\n\n**Commands:**\n• Upload .vmax.zip files - I'll automatically render them\n• Add `orbit=30` to your message for animations\n• `/queue` - See current render queue\n• `/history` - View recently completed renders\n• `/remove` - Cancel current rendering job";
-            
-            event.reply(help_message);
-            
-        } else if (event.command.get_command_name() == "queue") {
-            auto queue_jobs = work_queue.getQueueDisplay();
-            
-            if (queue_jobs.empty()) {
-                event.reply("🎉 No queued jobs! Any .vmax.zip file you send will be processed immediately!");
-            } else {
-                std::string queue_message = "";
-                size_t pending_position = 1;
-                
-                for (const auto& job : queue_jobs) {
-                    const std::string& filename = std::get<0>(job);
-                    const std::string& username = std::get<1>(job);
-                    bool is_processing = std::get<2>(job);
-                    int64_t bella_start_time = std::get<3>(job);
-                    
-                    if (is_processing) {
-                        std::string render_time_text = "";
-                        if (bella_start_time > 0) {
-                            int64_t elapsed_seconds = std::time(nullptr) - bella_start_time;
-                            int minutes = elapsed_seconds / 60;
-                            int seconds = elapsed_seconds % 60;
-                            
-                            if (minutes > 0) {
-                                render_time_text = " (" + std::to_string(minutes) + "m " + std::to_string(seconds) + "s)";
+    // Set up slash command handler
+    bot.on_slashcommand([&bot, &work_queue](const dpp::slashcommand_t& event) {
+        static int command_counter = 0;
+        int command_id = ++command_counter;
+        
+        std::cout << "\n=== COMMAND RECEIVED #" << command_id << " ===" << std::endl;
+        std::cout << "Command: " << event.command.get_command_name() << std::endl;
+        std::cout << "User: " << event.command.get_issuing_user().username << std::endl;
+        
+        if (event.command.get_command_name() == "help") {
+            std::string help_message = "🎮 I am a VoxelMax render bot! Drop .vmax.zip files and I'll convert them to beautiful images!\n\n**Commands:**\n• Upload .vmax.zip files - I'll automatically render them\n• Add `orbit=30` to your message for animations\n• Other options: `res=1024` `noise=5` or `samples=400` `fps=24` `view=top` `quality=fast`\n• `/queue` - See current render queue\n• `/history` - View recently completed renders\n• `/remove` - Cancel current rendering job";
+            
+            event.reply(help_message);
+            
+        } else if (event.command.get_command_name() == "queue") {
+            auto queue_jobs = work_queue.getQueueDisplay();
+            
+            if (queue_jobs.empty()) {
+                event.reply("🎉 No queued jobs! Any .vmax.zip file you send will be processed immediately!");
+            } else {
+                std::string queue_message = "";
+                size_t pending_position = 1;
+                
+                for (const auto& job : queue_jobs) {
+                    const std::string& filename = std::get<0>(job);
+                    const std::string& username = std::get<1>(job);
+                    bool is_processing = std::get<2>(job);
+                    int64_t bella_start_time = std::get<3>(job);
+                    double progress_percent = std::get<4>(job);
+                    const std::string& progress_pass = std::get<5>(job);
+                    int64_t progress_eta = std::get<6>(job);
+                    
+                    if (is_processing) {
+                        std::string render_time_text = "";
+                        if (bella_start_time > 0) {
+                            int64_t elapsed_seconds = std::time(nullptr) - bella_start_time;
+                            int minutes = elapsed_seconds / 60;
+                            int seconds = elapsed_seconds % 60;
+                            
+                            if (minutes > 0) {
+                                render_time_text = " (" + std::to_string(minutes) + "m " + std::to_string(seconds) + "s)";
+                            } else {
+                                render_time_text = " (" + std::to_string(seconds) + "s)";
+                            }
+                        }
+                        
+                        std::string progress_text = "";
+                        if (!progress_pass.empty()) {
+                            progress_text = " - " + std::to_string(static_cast<int>(progress_percent)) + "% " + progress_pass;
+                            if (progress_eta >= 0) {
+                                progress_text += ", ~" + (progress_eta >= 60 ? std::to_string(progress_eta / 60) + "m " : std::string()) 
+                                               + std::to_string(progress_eta % 60) + "s left";
+                            }
+                        }
+                        
+                        queue_message += "**Rendering:** `" + filename + "` - " + username + render_time_text + progress_text + "\n";
+                    } else {
+                        queue_message += std::to_string(pending_position) + ". `" + filename + "` - " + username + "\n";
+                        pending_position++;
+                    }
+                }
+                
+                event.reply(queue_message);
+            }
+            
+        } else if (event.command.get_command_name() == "history") {
+            auto history_jobs = work_queue.getHistory(10);
+            
+            if (history_jobs.empty()) {
+                event.reply("📜 No completed renders found in history.");
+            } else {
+                std::string history_message = "📜 **Recent Completed Renders:**\n\n";
+                
+                for (const auto& job : history_jobs) {
+                    const std::string& filename = std::get<0>(job);
+                    const std::string& username = std::get<1>(job);
+                    int64_t bella_start_time = std::get<2>(job);
+                    int64_t bella_end_time = std::get<3>(job);
+                    const std::string& quality_tier = std::get<5>(job);
+                    
+                    int64_t render_seconds = bella_end_time - bella_start_time;
+                    std::string render_time_text;
+                    
+                    if (render_seconds > 0) {
+                        int minutes = render_seconds / 60;
+                        int seconds = render_seconds % 60;
+                        
+                        if (minutes > 0) {
+                            render_time_text = " ⏱️ " + std::to_string(minutes) + "m " + std::to_string(seconds) + "s";
+                        } else {
+                            render_time_text = " ⏱️ " + std::to_string(seconds) + "s";
+                        }
+                    } else {
+                        render_time_text = " ⏱️ timing data incomplete";
+                    }
+                    
+                    if (!quality_tier.empty()) {
+                        render_time_text += " 🎚️ " + quality_tier;
+                    }
+                    
+                    history_message += "`" + filename + "` - " + username + render_time_text + "\n";
+                }
+                
+                event.reply(history_message);
+            }
+            
+        } else if (event.command.get_command_name() == "remove") {
+            uint64_t requesting_user_id = event.command.get_issuing_user().id;
+            bool is_admin = isAdminUser(requesting_user_id);
+            
+            bool is_job_owner = false;
+            auto job_owner_id = work_queue.getCurrentJobOwnerId();
+            if (job_owner_id == requesting_user_id) {
+                is_job_owner = true;
+            }
+            
+            if (!is_admin && !is_job_owner) {
+                event.reply("🚫 Access denied. You can only cancel your own jobs (or be an admin).");
+                return;
+            }
+            
+            std::string cancelled_filename = work_queue.cancelCurrentJob();
+            
+            if (!cancelled_filename.empty()) {
+                event.reply("🛑 **Cancelling VoxelMax render:** `" + cancelled_filename + "`");
+            } else {
+                event.reply("ℹ️ No job is currently being processed.");
+            }
+            
+        } else {
+            event.reply("⚠️ This command is no longer supported. Please use `/help`, `/queue`, `/history`, or `/remove`.");
+        }
+    });
+
+    // Helper function to register all slash commands
+    auto register_all_commands = [&bot]() {
+        std::cout << "Registering commands..." << std::endl;
+        
+        bot.global_command_create(dpp::slashcommand("help", "Show information about VoxelMax rendering commands", bot.me.id));
+        bot.global_command_create(dpp::slashcommand("queue", "Show current render queue status", bot.me.id));
+        bot.global_command_create(dpp::slashcommand("history", "Show recently completed renders with timing", bot.me.id));
+        bot.global_command_create(dpp::slashcommand("remove", "Cancel current processing job (admin or job owner)", bot.me.id));
+    };
+
+    // Set up bot ready event
+    bot.on_ready([&bot, register_all_commands](const dpp::ready_t& event) {
+	    if (dpp::run_once<struct register_bot_commands>()) {
+	        std::cout << "VoxelMax Bot is ready!" << std::endl;
+	        std::cout << "Bot user: " << bot.me.username << " (ID: " << bot.me.id << ")" << std::endl;
+	        register_all_commands();
+	    }
+    });
+
+    // Start the bot
+    std::cout << "Starting VoxelMax bot event loop..." << std::endl;
+    
+    std::thread bot_thread([&bot]() {
+        bot.start(dpp::st_wait);
+    });
+    
+    bot_thread.join();
+    
+    std::cout << "Bot shutting down, stopping worker thread..." << std::endl;
+    work_queue.requestShutdown();
+    worker.join();
+    engineObserver.setWorkQueue(nullptr);
+    engineObserver.setStatusBoard(nullptr);
+    statusBoard.stop();
+    
+    return 0;
+}
+
+//==============================================================================
+// VMAX MODEL PROCESSING FUNCTIONS
+//==============================================================================
+
+dl::bella_sdk::Node addModelToScene(const ConvertOptions& options,
+                                    JobScene& belScene, 
+                                    dl::bella_sdk::Node& belWorld, 
+                                    const oom::vmax::Model& vmaxModel, 
+                                    const DecodedPalette& palette, 
+                                    SceneBuildStats* stats) {
+    // Create Bella scene nodes for each voxel
+    dl::String modelName = dl::String(vmaxModel.vmaxbFileName.c_str());
+    dl::String canonicalName = modelName.replace(".vmaxb", "");
+    dl::bella_sdk::Node belCanonicalNode;
+    const std::string& mode = options.mode;
+    const bool greedyBox = options.greedy_box;
+    {
+        dl::bella_sdk::Scene::EventScope es(belScene.scene);
+
+        auto belVoxel = belScene.findNode("oomVoxel");
+        auto belLiqVoxel = belScene.findNode("oomLiqVoxel");
+        auto belMeshVoxel = belScene.findNode("oomMeshVoxel");
+        auto belVoxelForm = belScene.findNode("oomEmitterBlockXform");
+
+        auto modelXform = belScene.createNode("xform", canonicalName, canonicalName);
+        modelXform["steps"][0]["xform"] = dl::Mat4 {1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1};
+        for (const auto& [material, colorID] : vmaxModel.getUsedMaterialsAndColors()) {
+            for (int color : colorID) {
+
+                auto thisname = canonicalName + dl::String("Material") + dl::String(material) + dl::String("Color") + dl::String(color);
+
+                // Identical resolved materials are shared across every model in the job
+                auto belMaterial = sharedMaterial(belScene, 
+                                                  resolveMaterialKey(material, color, palette, options.bevel), 
+                                                  stats);
+                bool isMesh = false;
+                bool isBox = true;
+
+                if (material == 7 || mode == "mesh" || mode == "both") {
+                    isMesh = true;
+                    isBox = false;
+                }
+
+                // Get all voxels for this material/color combination
+                const std::vector<oom::vmax::Voxel>& voxelsOfType = vmaxModel.getVoxels(material, color);
+
+                // Merged boxes are built lazily and reused once counted
+                std::vector<VoxelBox> boxes;
+
+                // Liquids always mesh, everything else is decided per bucket before meshing it
+                BucketSurface surface;
+                const bool costModelled = mode == "auto" && material != 7 && !voxelsOfType.empty();
+                if (costModelled) {
+                    if (greedyBox) {
+                        boxes = greedyBoxesFromVoxels(voxelsOfType);
+                    }
+                    surface = measureBucketSurface(voxelsOfType);
+                    isMesh = preferMeshForBucket(options.cost_model, 
+                                                 thisname, 
+                                                 voxelsOfType.size(), 
+                                                 greedyBox ? boxes.size() : voxelsOfType.size(), 
+                                                 surface);
+                    isBox = !isMesh;
+                }
+
+                if (isMesh) {
+                    auto belMeshXform  = belScene.createNode("xform",
+                        thisname+dl::String("Xform"));
+                    belMeshXform.parentTo(modelXform);
+
+                    if (voxelsOfType.size() > 0) {
+                        // Merge coplanar exposed faces of this color into maximal quads
+                        VoxelQuadMesh quadMesh = greedyMeshFromVoxels(voxelsOfType);
+                        if (costModelled) {
+                            std::cout << "⚖️ " << thisname.buf() << " quads=" << quadMesh.quads.size() 
+                                      << " (estimated " << surface.face_runs << ")" << std::endl;
+                        }
+                        if (stats) {
+                            stats->mesh_faces += quadMesh.exposed_faces;
+                            stats->mesh_quads += quadMesh.quads.size();
+                        }
+
+                        auto belMesh = add_quad_mesh_to_scene(  thisname,
+                                                                quadMesh,
+                                                                belScene );
+                        belMesh.parentTo(belMeshXform);
+                        belMeshXform["material"] = belMaterial;
+                    } else { 
+                        std::cout << "skipping" << color << "\n";
+                    }
+                }
+                if (isBox) {
+                    auto addInstancer = [&](const dl::String& instancerName, const dl::ds::Vector<dl::Mat4f>& xformsArray) {
+                        auto belInstancer  = belScene.createNode("instancer",
+                            instancerName);
+                        belInstancer["steps"][0]["xform"] = dl::Mat4 {1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1};
+                        belInstancer.parentTo(modelXform);
+                        belInstancer["steps"][0]["instances"] = xformsArray;
+                        belInstancer["material"] = belMaterial;
+                        if(material==7) {
+                            belLiqVoxel.parentTo(belInstancer);
+                        } else {
+                            belMeshVoxel.parentTo(belInstancer);
+                        }
+                        if(palette.materials[material].emission > 0.0f) {
+                            belVoxelForm.parentTo(belInstancer);
+                        }
+                        if (stats) {
+                            stats->instance_count += xformsArray.size();
+                            stats->instancer_count++;
+                        }
+                    };
+                    if (stats) {
+                        stats->voxel_count += voxelsOfType.size();
+                    }
+
+                    if (options.chunk_instancers) {
+                        // Tighter per-node bounds: one instancer per VoxelMax chunk, in Morton order
+                        for (const auto& [chunkMorton, chunkVoxels] : splitVoxelsByChunk(voxelsOfType)) {
+                            dl::ds::Vector<dl::Mat4f> xformsArray;
+                            if (greedyBox) {
+                                fillBoxInstances(greedyBoxesFromVoxels(chunkVoxels), xformsArray);
                             } else {
-                                render_time_text = " (" + std::to_string(seconds) + "s)";
+                                fillVoxelInstances(chunkVoxels, xformsArray);
                             }
+                            addInstancer(thisname + dl::String("Chunk") + dl::String(static_cast<int>(chunkMorton)), xformsArray);
                         }
-                        
-                        queue_message += "**Rendering:** `" + filename + "` - " + username + render_time_text + "\n";
                     } else {
-                        queue_message += std::to_string(pending_position) + ". `" + filename + "` - " + username + "\n";
-                        pending_position++;
-                    }
-                }
-                
-                event.reply(queue_message);
-            }
-            
-        } else if (event.command.get_command_name() == "history") {
-            auto history_jobs = work_queue.getHistory(10);
-            
-            if (history_jobs.empty()) {
-                event.reply("📜 No completed renders found in history.");
-            } else {
-                std::string history_message = "📜 **Recent Completed Renders:**\n\n";
-                
-                for (const auto& job : history_jobs) {
-                    const std::string& filename = std::get<0>(job);
-                    const std::string& username = std::get<1>(job);
-                    int64_t bella_start_time = std::get<2>(job);
-                    int64_t bella_end_time = std::get<3>(job);
-                    
-                    int64_t render_seconds = bella_end_time - bella_start_time;
-                    std::string render_time_text;
-                    
-                    if (render_seconds > 0) {
-                        int minutes = render_seconds / 60;
-                        int seconds = render_seconds % 60;
-                        
-                        if (minutes > 0) {
-                            render_time_text = " ⏱️ " + std::to_string(minutes) + "m " + std::to_string(seconds) + "s";
+                        dl::ds::Vector<dl::Mat4f> xformsArray;
+                        if (greedyBox) {
+                            if (boxes.empty()) {
+                                boxes = greedyBoxesFromVoxels(voxelsOfType);
+                            }
+                            fillBoxInstances(boxes, xformsArray);
                         } else {
-                            render_time_text = " ⏱️ " + std::to_string(seconds) + "s";
+                            fillVoxelInstances(voxelsOfType, xformsArray);
                         }
-                    } else {
-                        render_time_text = " ⏱️ timing data incomplete";
+                        addInstancer(thisname, xformsArray);
                     }
-                    
-                    history_message += "`" + filename + "` - " + username + render_time_text + "\n";
                 }
-                
-                event.reply(history_message);
             }
-            
-        } else if (event.command.get_command_name() == "remove") {
-            const std::vector<uint64_t> ADMIN_USER_IDS = {
-                780541438022254624ULL  // harvey
-            };
-            
-            uint64_t requesting_user_id = event.command.get_issuing_user().id;
-            bool is_admin = std::find(ADMIN_USER_IDS.begin(), ADMIN_USER_IDS.end(), requesting_user_id) != ADMIN_USER_IDS.end();
-            
-            bool is_job_owner = false;
-            auto job_owner_id = work_queue.getCurrentJobOwnerId();
-            if (job_owner_id == requesting_user_id) {
-                is_job_owner = true;
+        }
+        return modelXform;
+    }
+    return dl::bella_sdk::Node();
+}
+
+/**
+ * Row-vector product a * b, so a is applied first (child * parent)
+ */
+oom::vmax::Matrix4x4 multiplyMatrices(const oom::vmax::Matrix4x4& a, const oom::vmax::Matrix4x4& b) {
+    oom::vmax::Matrix4x4 result = a;
+    for (int row = 0; row < 4; row++) {
+        for (int col = 0; col < 4; col++) {
+            double sum = 0.0;
+            for (int k = 0; k < 4; k++) {
+                sum += a.m[row][k] * b.m[k][col];
             }
-            
-            if (!is_admin && !is_job_owner) {
-                event.reply("🚫 Access denied. You can only cancel your own jobs (or be an admin).");
-                return;
+            result.m[row][col] = sum;
+        }
+    }
+    return result;
+}
+
+/**
+ * parentId of every scene.json group, with cycles cut
+ * Chains are walked iteratively; a group reached twice on one chain (a self parent or a
+ * loop through other groups) loses its parent and becomes a root, with a warning
+ */
+std::map<std::string, std::string> acyclicGroupParents(const std::map<std::string, oom::vmax::JsonGroupInfo>& jsonGroups) {
+    std::map<std::string, std::string> parents;
+    for (const auto& [groupId, groupInfo] : jsonGroups) {
+        parents[groupId] = groupInfo.parentId;
+    }
+
+    enum class Visit { OnChain, Done };
+    std::map<std::string, Visit> visits;
+    std::vector<std::string> chain;
+    for (const auto& [groupId, groupInfo] : jsonGroups) {
+        chain.clear();
+        std::string current = groupId;
+        while (!current.empty() && parents.count(current)) {
+            auto visit = visits.find(current);
+            if (visit != visits.end()) {
+                if (visit->second == Visit::OnChain) {
+                    std::cout << "⚠️ scene.json group " << current << " is its own ancestor, treating it as a root" << std::endl;
+                    parents[current] = "";
+                }
+                break;
             }
-            
-            std::string cancelled_filename = work_queue.cancelCurrentJob();
-            
-            if (!cancelled_filename.empty()) {
-                event.reply("🛑 **Cancelling VoxelMax render:** `" + cancelled_filename + "`");
-            } else {
-                event.reply("ℹ️ No job is currently being processed.");
+            visits[current] = Visit::OnChain;
+            chain.push_back(current);
+            current = parents[current];
+        }
+        for (const std::string& visited : chain) {
+            visits[visited] = Visit::Done;
+        }
+    }
+    return parents;
+}
+
+/**
+ * World matrix (local * parent chain) of every scene.json group, each resolved once
+ * Parents come from acyclicGroupParents; groups whose parent is missing are treated as roots.
+ * Chains are walked iteratively so nesting depth is not bounded by the stack.
+ */
+std::map<std::string, oom::vmax::Matrix4x4> groupWorldMatrices(const std::map<std::string, oom::vmax::JsonGroupInfo>& jsonGroups, 
+                                                               const std::map<std::string, std::string>& groupParents) {
+    std::map<std::string, oom::vmax::Matrix4x4> groupWorld;
+    std::vector<std::string> chain;
+    for (const auto& [groupId, groupInfo] : jsonGroups) {
+        // Climb to the first resolved group or root, then resolve back down
+        chain.clear();
+        std::string current = groupId;
+        while (!current.empty() && jsonGroups.count(current) && !groupWorld.count(current)) {
+            chain.push_back(current);
+            current = groupParents.at(current);
+        }
+        auto resolved = groupWorld.find(current);
+        const oom::vmax::Matrix4x4* parent = resolved != groupWorld.end() ? &resolved->second : nullptr;
+
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            const auto& info = jsonGroups.at(*it);
+            oom::vmax::Matrix4x4 local = oom::vmax::combineTransforms(info.rotation[0], info.rotation[1], info.rotation[2], info.rotation[3],
+                                                                      info.position[0], info.position[1], info.position[2], 
+                                                                      info.scale[0], info.scale[1], info.scale[2]);
+            parent = &groupWorld.emplace(*it, parent ? multiplyMatrices(local, *parent) : local).first->second;
+        }
+    }
+    return groupWorld;
+}
+
+/**
+ * World space bounding box of every model instance in scene.json
+ * Each model's local voxel bounds are pushed through the instance matrix and its group chain,
+ * so the cost is one 8 corner transform per instance instead of one per voxel
+ */
+template <typename ModelContentMap>
+dl::Aabb sceneBoundsFromModels(const ModelContentMap& modelVmaxbMap, 
+                               const std::map<std::string, oom::vmax::Matrix4x4>& groupWorld, 
+                               const std::map<std::string, VoxelBounds>& modelBounds) {
+    // Initialize bbox to "inverted infinity" so first point will always expand it
+    dl::Aabb sceneBbox;
+    sceneBbox.min = dl::Pos3::make(std::numeric_limits<double>::max(), 
+                                   std::numeric_limits<double>::max(), 
+                                   std::numeric_limits<double>::max());
+    sceneBbox.max = dl::Pos3::make(std::numeric_limits<double>::lowest(), 
+                                   std::numeric_limits<double>::lowest(), 
+                                   std::numeric_limits<double>::lowest());
+
+    for (const auto& [vmaxContentName, vmaxModelList] : modelVmaxbMap) {
+        auto boundsIt = modelBounds.find(vmaxContentName);
+        if (boundsIt == modelBounds.end() || boundsIt->second.empty()) {
+            continue;
+        }
+        const VoxelBounds& bounds = boundsIt->second;
+
+        for (const auto& jsonModelInfo : vmaxModelList) {
+            oom::vmax::Matrix4x4 world = oom::vmax::combineTransforms(jsonModelInfo.rotation[0], jsonModelInfo.rotation[1], jsonModelInfo.rotation[2], jsonModelInfo.rotation[3],
+                                                                      jsonModelInfo.position[0], jsonModelInfo.position[1], jsonModelInfo.position[2], 
+                                                                      jsonModelInfo.scale[0], jsonModelInfo.scale[1], jsonModelInfo.scale[2]);
+            auto parentWorld = groupWorld.find(jsonModelInfo.parentId);
+            if (parentWorld != groupWorld.end()) {
+                world = multiplyMatrices(world, parentWorld->second);
             }
-            
-        } else {
-            event.reply("⚠️ This command is no longer supported. Please use `/help`, `/queue`, `/history`, or `/remove`.");
+
+            // Voxel cells span [min, max + 1]
+            for (int corner = 0; corner < 8; corner++) {
+                double p[3] = {
+                    static_cast<double>((corner & 1) ? bounds.max[0] + 1 : bounds.min[0]),
+                    static_cast<double>((corner & 2) ? bounds.max[1] + 1 : bounds.min[1]),
+                    static_cast<double>((corner & 4) ? bounds.max[2] + 1 : bounds.min[2])
+                };
+                double w[3];
+                for (int col = 0; col < 3; col++) {
+                    w[col] = p[0] * world.m[0][col] + p[1] * world.m[1][col] + p[2] * world.m[2][col] + world.m[3][col];
+                }
+                if (w[0] < sceneBbox.min.x) sceneBbox.min.x = w[0];
+                if (w[1] < sceneBbox.min.y) sceneBbox.min.y = w[1];
+                if (w[2] < sceneBbox.min.z) sceneBbox.min.z = w[2];
+                if (w[0] > sceneBbox.max.x) sceneBbox.max.x = w[0];
+                if (w[1] > sceneBbox.max.y) sceneBbox.max.y = w[1];
+                if (w[2] > sceneBbox.max.z) sceneBbox.max.z = w[2];
+            }
+        }
+    }
+    return sceneBbox;
+}
+
+/**
+ * Maps a VoxelMax material slot and palette color onto quickMaterial parameters
+ * Color index is 1-based, VoxelMax uses 0 for "no voxel"
+ */
+BellaMaterialKey resolveMaterialKey(int material, 
+                                    int color, 
+                                    const DecodedPalette& palette, 
+                                    bool bevel) {
+    BellaMaterialKey key;
+    const std::array<oom::vmax::Material, 8>& vmaxMaterial = palette.materials;
+    const oom::vmax::RGBA& rgba = palette.colors[color-1];
+    if(material==7) {
+        key.type = "liquid";
+    } else if(material==6 || rgba.a < 255) {
+        key.type = "glass";
+        key.roughness = vmaxMaterial[material].roughness * 100.0f;
+    } else if(vmaxMaterial[material].metalness > 0.1f) {
+        key.type = "metal";
+        key.roughness = vmaxMaterial[material].roughness * 100.0f;
+    } else if(vmaxMaterial[material].transmission > 0.0f) {
+        key.type = "dielectric";
+        key.transmission = vmaxMaterial[material].transmission;
+    } else if(vmaxMaterial[material].emission > 0.0f) {
+        key.type = "emitter";
+        key.emitter_energy = vmaxMaterial[material].emission*100.0f;
+    } else if(vmaxMaterial[material].roughness > 0.8999f) {
+        key.type = "diffuse";
+    } else {
+        key.type = "plastic";
+        key.roughness = vmaxMaterial[material].roughness * 100.0f;
+    }
+    key.bevel = bevel && material != 7;
+    std::copy(palette.linear[color-1].begin(), palette.linear[color-1].end(), key.color);
+    return key;
+}
+
+/**
+ * Wraps palette colors and material slots, precomputing the linear RGBA table
+ */
+DecodedPalette makeDecodedPalette(std::vector<oom::vmax::RGBA> colors, 
+                                  const std::array<oom::vmax::Material, 8>& materials) {
+    DecodedPalette palette;
+    palette.colors = std::move(colors);
+    palette.materials = materials;
+    palette.linear.reserve(palette.colors.size());
+    for (const auto& rgba : palette.colors) {
+        // Convert 0-255 to 0-1 
+        palette.linear.push_back({
+            oom::misc::srgbToLinear(static_cast<double>(rgba.r)/255.0), 
+            oom::misc::srgbToLinear(static_cast<double>(rgba.g)/255.0), 
+            oom::misc::srgbToLinear(static_cast<double>(rgba.b)/255.0), 
+            static_cast<double>(rgba.a)/255.0
+        });
+    }
+    return palette;
+}
+
+/**
+ * Reads paletteN.png and parses the materials stored in paletteN.settings.vmaxpsb
+ */
+DecodedPalette decodePalette(const std::string& pngPath, const std::string& settingsPath) {
+    std::vector<oom::vmax::RGBA> colors = oom::vmax::read256x1PaletteFromPNG(pngPath);
+    if (colors.empty()) { 
+        throw std::runtime_error(std::string("Failed to read palette from: ") + pngPath); 
+    }
+    plist_t plist_material = oom::vmax::readPlist(settingsPath, false);
+    return makeDecodedPalette(std::move(colors), oom::vmax::getMaterials(plist_material));
+}
+
+/**
+ * Decodes every snapshot of a contentsN.vmaxb plist file (lzfse compressed) into chunks
+ */
+std::vector<RawChunk> decodeVmaxbChunks(const std::string& vmaxbPath) {
+    std::vector<RawChunk> chunks;
+    plist_t plist_model_root = oom::vmax::readPlist(vmaxbPath, true);
+
+    plist_t plist_snapshots_array = plist_dict_get_item(plist_model_root, "snapshots");
+    uint32_t snapshots_array_size = plist_array_get_size(plist_snapshots_array);
+    chunks.reserve(snapshots_array_size);
+    for (uint32_t i = 0; i < snapshots_array_size; i++) {
+        plist_t plist_snapshot = plist_array_get_item(plist_snapshots_array, i);
+        plist_t plist_datastream = oom::vmax::getNestedPlistNode(plist_snapshot, {"s", "ds"});
+        RawChunk chunk;
+        chunk.info = oom::vmax::vmaxChunkInfo(plist_snapshot);
+        chunk.voxels = oom::vmax::vmaxVoxelInfo(plist_datastream, chunk.info.id, chunk.info.mortoncode);
+        chunks.push_back(std::move(chunk));
+    }
+    if (plist_model_root) {
+        plist_free(plist_model_root);
+    }
+    return chunks;
+}
+
+/**
+ * Model cache key: SHA-256 of the vmaxb, palette png and settings bytes, then the cache
+ * version so a converter change invalidates every entry. The cache directory is shared
+ * by every user of the bot, so the key has to be collision resistant.
+ */
+ContentDigest modelCacheKey(const std::string& vmaxbPath, const std::string& pngPath, const std::string& settingsPath) {
+    Sha256 sha;
+    digestFileContents(vmaxbPath, sha);
+    digestFileContents(pngPath, sha);
+    digestFileContents(settingsPath, sha);
+    uint8_t versionBytes[4];
+    for (int i = 0; i < 4; i++) {
+        versionBytes[i] = static_cast<uint8_t>(kModelCacheVersion >> (i * 8));
+    }
+    sha.update(versionBytes, sizeof(versionBytes));
+    return sha.finish();
+}
+
+/**
+ * Cache file for a key: <cacheDir>/<64 hex digits>.vmaxcache
+ */
+std::string modelCachePath(const std::string& cacheDir, const ContentDigest& key) {
+    std::string name;
+    name.reserve(key.size() * 2 + 10);
+    char hex[3];
+    for (uint8_t byte : key) {
+        std::snprintf(hex, sizeof(hex), "%02x", byte);
+        name += hex;
+    }
+    name += ".vmaxcache";
+    return (std::filesystem::path(cacheDir) / name).string();
+}
+
+/**
+ * Key of a whole upload's .vmaxscene: SHA-256 of the .vmax.zip bytes, then the decode and
+ * file format versions, so either change makes every kept scene miss
+ */
+ContentDigest sceneIntermediateKey(const std::vector<uint8_t>& upload) {
+    Sha256 sha;
+    sha.update(upload.data(), upload.size());
+    uint8_t versionBytes[8];
+    for (int i = 0; i < 4; i++) {
+        versionBytes[i] = static_cast<uint8_t>(kModelCacheVersion >> (i * 8));
+        versionBytes[4 + i] = static_cast<uint8_t>(kSceneIntermediateVersion >> (i * 8));
+    }
+    sha.update(versionBytes, sizeof(versionBytes));
+    return sha.finish();
+}
+
+/**
+ * Kept scene for a key: <cacheDir>/<64 hex digits>.vmaxscene, evicted with the model cache
+ */
+std::string sceneIntermediatePath(const std::string& cacheDir, const ContentDigest& key) {
+    return std::filesystem::path(modelCachePath(cacheDir, key)).replace_extension(".vmaxscene").string();
+}
+
+/**
+ * Loads decoded chunks written by storeCachedModel
+ * Layout: "VMXC", version, the 32 byte key, chunk count, then per chunk id, mortoncode,
+ * voxel count and 5 bytes per voxel (x, y, z, material, palette); all integers little endian uint32.
+ * The stored key must match and every count must fit in the file, otherwise the entry misses.
+ * A hit refreshes the file time, which trimModelCache uses as last use.
+ */
+bool loadCachedModel(const std::string& cacheDir, const ContentDigest& key, std::vector<RawChunk>& chunks) {
+    std::string path = modelCachePath(cacheDir, key);
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    uint64_t remaining = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+    auto readU32 = [&file, &remaining]() {
+        unsigned char bytes[4] = {0, 0, 0, 0};
+        file.read(reinterpret_cast<char*>(bytes), 4);
+        remaining = remaining >= 4 ? remaining - 4 : 0;
+        return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) | 
+               (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    };
+
+    char magic[4] = {0, 0, 0, 0};
+    ContentDigest storedKey{};
+    if (remaining < sizeof(magic) + 4 + storedKey.size() + 4) {
+        return false;
+    }
+    file.read(magic, 4);
+    remaining -= 4;
+    if (std::memcmp(magic, "VMXC", 4) != 0 || readU32() != kModelCacheVersion) {
+        return false;
+    }
+    file.read(reinterpret_cast<char*>(storedKey.data()), storedKey.size());
+    remaining -= storedKey.size();
+    if (storedKey != key) {
+        std::cout << "⚠️ Ignoring model cache entry " << path << " stored under another key" << std::endl;
+        return false;
+    }
+
+    auto corrupt = [&]() {
+        std::cout << "⚠️ Ignoring truncated model cache entry " << path << std::endl;
+        chunks.clear();
+        return false;
+    };
+    uint32_t chunkCount = readU32();
+    if (static_cast<uint64_t>(chunkCount) * 12 > remaining) {
+        return corrupt();
+    }
+    chunks.clear();
+    chunks.reserve(chunkCount);
+    std::vector<unsigned char> packed;
+    for (uint32_t c = 0; c < chunkCount && file; c++) {
+        RawChunk chunk;
+        if (remaining < 12) {
+            return corrupt();
+        }
+        chunk.info.id = readU32();
+        chunk.info.mortoncode = readU32();
+        uint32_t voxelCount = readU32();
+        if (static_cast<uint64_t>(voxelCount) * 5 > remaining) {
+            return corrupt();
+        }
+        packed.resize(static_cast<size_t>(voxelCount) * 5);
+        file.read(reinterpret_cast<char*>(packed.data()), packed.size());
+        remaining -= packed.size();
+        chunk.voxels.resize(voxelCount);
+        for (uint32_t v = 0; v < voxelCount; v++) {
+            oom::vmax::Voxel& voxel = chunk.voxels[v];
+            voxel.x = packed[v * 5];
+            voxel.y = packed[v * 5 + 1];
+            voxel.z = packed[v * 5 + 2];
+            voxel.material = packed[v * 5 + 3];
+            voxel.palette = packed[v * 5 + 4];
+        }
+        chunks.push_back(std::move(chunk));
+    }
+    if (!file) {
+        return corrupt();
+    }
+
+    std::error_code ec;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+    return true;
+}
+
+/**
+ * Writes decoded chunks to the cache through a temporary file and rename, so a
+ * concurrent reader never sees a partial entry. Failures only cost a later cache miss.
+ */
+void storeCachedModel(const std::string& cacheDir, const ContentDigest& key, const std::vector<RawChunk>& chunks) {
+    std::error_code ec;
+    std::filesystem::create_directories(cacheDir, ec);
+    std::string finalPath = modelCachePath(cacheDir, key);
+    std::string tempPath = finalPath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cout << "⚠️ Cannot write model cache entry " << tempPath << std::endl;
+            return;
+        }
+        auto writeU32 = [&file](uint32_t value) {
+            unsigned char bytes[4] = {
+                static_cast<unsigned char>(value), 
+                static_cast<unsigned char>(value >> 8), 
+                static_cast<unsigned char>(value >> 16), 
+                static_cast<unsigned char>(value >> 24)
+            };
+            file.write(reinterpret_cast<const char*>(bytes), 4);
+        };
+
+        file.write("VMXC", 4);
+        writeU32(kModelCacheVersion);
+        file.write(reinterpret_cast<const char*>(key.data()), key.size());
+        writeU32(static_cast<uint32_t>(chunks.size()));
+        std::vector<unsigned char> packed;
+        for (const RawChunk& chunk : chunks) {
+            writeU32(chunk.info.id);
+            writeU32(chunk.info.mortoncode);
+            writeU32(static_cast<uint32_t>(chunk.voxels.size()));
+            packed.resize(chunk.voxels.size() * 5);
+            for (size_t v = 0; v < chunk.voxels.size(); v++) {
+                const oom::vmax::Voxel& voxel = chunk.voxels[v];
+                packed[v * 5] = voxel.x;
+                packed[v * 5 + 1] = voxel.y;
+                packed[v * 5 + 2] = voxel.z;
+                packed[v * 5 + 3] = voxel.material;
+                packed[v * 5 + 4] = voxel.palette;
+            }
+            file.write(reinterpret_cast<const char*>(packed.data()), packed.size());
+        }
+        if (!file) {
+            std::cout << "⚠️ Failed writing model cache entry " << tempPath << std::endl;
+            file.close();
+            std::filesystem::remove(tempPath, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(tempPath, finalPath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+    }
+}
+
+/**
+ * Evicts the least recently used cache entries until the directory holds at most maxBytes
+ * Entries are model .vmaxcache files and kept .vmaxscene files; last use is the file time,
+ * set on write and refreshed by every hit
+ */
+void trimModelCache(const std::string& cacheDir, uint64_t maxBytes) {
+    std::error_code ec;
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> entries;
+    uint64_t totalBytes = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(cacheDir, ec)) {
+        if (entry.path().extension() != ".vmaxcache" && entry.path().extension() != ".vmaxscene") {
+            continue;
+        }
+        uint64_t size = entry.file_size(ec);
+        if (ec) {
+            continue;
+        }
+        entries.emplace_back(entry.last_write_time(ec), entry.path());
+        totalBytes += size;
+    }
+    if (totalBytes <= maxBytes) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end());
+    size_t evicted = 0;
+    for (const auto& [lastUse, path] : entries) {
+        if (totalBytes <= maxBytes) {
+            break;
+        }
+        uint64_t size = std::filesystem::file_size(path, ec);
+        if (!ec && std::filesystem::remove(path, ec)) {
+            totalBytes -= size;
+            evicted++;
+        }
+    }
+    std::cout << "🧹 Evicted " << evicted << " model cache entries, " << (totalBytes >> 20) 
+              << " MB left in " << cacheDir << std::endl;
+}
+
+Sha256::Sha256() {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    std::memcpy(state, initial, sizeof(state));
+}
+
+void Sha256::compress(const uint8_t block[64]) {
+    static const uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+    auto rotr = [](uint32_t x, int n) { return (x >> n) | (x << (32 - n)); };
+
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (static_cast<uint32_t>(block[i * 4]) << 24) | (static_cast<uint32_t>(block[i * 4 + 1]) << 16) | 
+               (static_cast<uint32_t>(block[i * 4 + 2]) << 8) | static_cast<uint32_t>(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + k[i] + w[i];
+        uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void Sha256::update(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    total_bytes += size;
+    while (size > 0) {
+        size_t take = std::min(size, sizeof(buffer) - buffered);
+        std::memcpy(buffer + buffered, bytes, take);
+        buffered += take;
+        bytes += take;
+        size -= take;
+        if (buffered == sizeof(buffer)) {
+            compress(buffer);
+            buffered = 0;
+        }
+    }
+}
+
+std::array<uint8_t, 32> Sha256::finish() {
+    uint64_t bitLength = total_bytes * 8;
+    const uint8_t pad = 0x80;
+    update(&pad, 1);
+    const uint8_t zero = 0;
+    while (buffered != 56) {
+        update(&zero, 1);
+    }
+    uint8_t lengthBytes[8];
+    for (int i = 0; i < 8; i++) {
+        lengthBytes[i] = static_cast<uint8_t>(bitLength >> (56 - i * 8));
+    }
+    update(lengthBytes, 8);
+
+    std::array<uint8_t, 32> digest;
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+    }
+    return digest;
+}
+
+/**
+ * Feeds a file's bytes and then its byte count into sha; a missing file feeds as empty
+ * The trailing count keeps consecutive files from shifting bytes between each other
+ */
+void digestFileContents(const std::string& path, Sha256& sha) {
+    std::ifstream file(path, std::ios::binary);
+    char buffer[65536];
+    uint64_t size = 0;
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        sha.update(buffer, static_cast<size_t>(file.gcount()));
+        size += static_cast<uint64_t>(file.gcount());
+    }
+    uint8_t sizeBytes[8];
+    for (int i = 0; i < 8; i++) {
+        sizeBytes[i] = static_cast<uint8_t>(size >> (i * 8));
+    }
+    sha.update(sizeBytes, sizeof(sizeBytes));
+}
+
+/**
+ * FNV-1a over the resolved parameters
+ * Values are hashed plus 0 so -0 and 0, which operator== treats as equal, hash the same
+ */
+size_t BellaMaterialKeyHash::operator()(const BellaMaterialKey& key) const {
+    uint64_t hash = 1469598103934665603ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+    auto mixFloat = [&mix](float value) {
+        value += 0.0f;
+        mix(&value, sizeof(value));
+    };
+    mix(key.type.data(), key.type.size());
+    mixFloat(key.roughness);
+    mixFloat(key.transmission);
+    mixFloat(key.emitter_energy);
+    for (double channel : key.color) {
+        channel += 0.0;
+        mix(&channel, sizeof(channel));
+    }
+    mix(&key.bevel, sizeof(key.bevel));
+    return static_cast<size_t>(hash);
+}
+
+/**
+ * Returns the job's quickMaterial for these parameters, creating it on first use
+ */
+dl::bella_sdk::Node sharedMaterial(JobScene& belScene, 
+                                   const BellaMaterialKey& key, 
+                                   SceneBuildStats* stats) {
+    if (stats) {
+        stats->material_buckets++;
+    }
+    auto found = belScene.materials.find(key);
+    if (found != belScene.materials.end()) {
+        return found->second;
+    }
+
+    auto belMaterial = belScene.createNode("quickMaterial", 
+        belScene.root.name() + dl::String("vmaxMat") + dl::String(static_cast<int>(belScene.materials.size())));
+    belMaterial["type"] = key.type.c_str();
+    if (key.type == "liquid") {
+        belMaterial["liquidDepth"] = 300.0f;
+        belMaterial["liquidIor"] = 1.33f;
+    } else if (key.type == "glass") {
+        belMaterial["roughness"] = key.roughness;
+        belMaterial["glassDepth"] = 500.0f;
+    } else if (key.type == "metal" || key.type == "plastic") {
+        belMaterial["roughness"] = key.roughness;
+    } else if (key.type == "dielectric") {
+        belMaterial["transmission"] = key.transmission;
+    } else if (key.type == "emitter") {
+        belMaterial["emitterUnit"] = "radiance";
+        belMaterial["emitterEnergy"] = key.emitter_energy;
+    }
+    if (key.bevel) {
+        belMaterial["bevel"] = belScene.findNode("oomBevel");
+    }
+    belMaterial["color"] = dl::Rgba{key.color[0], key.color[1], key.color[2], key.color[3]};
+
+    belScene.materials.emplace(key, belMaterial);
+    if (stats) {
+        stats->material_nodes++;
+    }
+    return belMaterial;
+}
+
+dl::bella_sdk::Node add_quad_mesh_to_scene( dl::String name, 
+                                            const VoxelQuadMesh& quadMesh, 
+                                            JobScene& belScene ) {
+
+    auto belMesh = belScene.createNode("mesh", name+"mesh", name+"mesh");
+    belMesh["normals"] = "flat";
+    // Add vertices and faces to the mesh
+    // Both arrays are sized once and filled in parallel chunks
+    dl::ds::Vector<dl::Pos3f> verticesArray;
+    verticesArray.resize(quadMesh.points.size());
+    parallelChunks(quadMesh.points.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const auto& point = quadMesh.points[i];
+            verticesArray[i] = dl::Pos3f{ static_cast<float>(point[0]), 
+                                          static_cast<float>(point[1]), 
+                                          static_cast<float>(point[2]) };
         }
     });
+    belMesh["steps"][0]["points"] = verticesArray;
 
-    // Helper function to register all slash commands
-    auto register_all_commands = [&bot]() {
-        std::cout << "Registering commands..." << std::endl;
-        
-        bot.global_command_create(dpp::slashcommand("help", "Show information about VoxelMax rendering commands", bot.me.id));
-        bot.global_command_create(dpp::slashcommand("queue", "Show current render queue status", bot.me.id));
-        bot.global_command_create(dpp::slashcommand("history", "Show recently completed renders with timing", bot.me.id));
-        bot.global_command_create(dpp::slashcommand("remove", "Cancel current processing job (admin or job owner)", bot.me.id));
-    };
+    dl::ds::Vector<dl::Vec4u> facesArray;
+    facesArray.resize(quadMesh.quads.size());
+    parallelChunks(quadMesh.quads.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const auto& quad = quadMesh.quads[i];
+            facesArray[i] = dl::Vec4u{ quad[0], quad[1], quad[2], quad[3] };
+        }
+    });
+    belMesh["polygons"] = facesArray;
+    return belMesh;
+}
 
-    // Set up bot ready event
-    bot.on_ready([&bot, register_all_commands](const dpp::ready_t& event) {
-	    if (dpp::run_once<struct register_bot_commands>()) {
-	        std::cout << "VoxelMax Bot is ready!" << std::endl;
-	        std::cout << "Bot user: " << bot.me.username << " (ID: " << bot.me.id << ")" << std::endl;
-	        register_all_commands();
-	    }
+/**
+ * Writes one unit cube transform per voxel, centered on the voxel
+ * The array is sized once and filled in parallel chunks
+ */
+void fillVoxelInstances(const std::vector<oom::vmax::Voxel>& voxels, dl::ds::Vector<dl::Mat4f>& xformsArray) {
+    xformsArray.resize(voxels.size());
+    parallelChunks(voxels.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const auto& eachvoxel = voxels[i];
+            xformsArray[i] = dl::Mat4f{  1, 0, 0, 0, 
+                                         0, 1, 0, 0, 
+                                         0, 0, 1, 0, 
+                                         (static_cast<float>(eachvoxel.x))+0.5f,
+                                         (static_cast<float>(eachvoxel.y))+0.5f,
+                                         (static_cast<float>(eachvoxel.z))+0.5f, 1 };
+        }
     });
+}
 
-    // Start the bot
-    std::cout << "Starting VoxelMax bot event loop..." << std::endl;
-    
-    std::thread bot_thread([&bot]() {
-        bot.start(dpp::st_wait);
+/**
+ * Writes one scaled unit cube transform per merged box, centered on the box
+ */
+void fillBoxInstances(const std::vector<VoxelBox>& boxes, dl::ds::Vector<dl::Mat4f>& xformsArray) {
+    xformsArray.resize(boxes.size());
+    parallelChunks(boxes.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const auto& box = boxes[i];
+            float sx = static_cast<float>(box.sx);
+            float sy = static_cast<float>(box.sy);
+            float sz = static_cast<float>(box.sz);
+            xformsArray[i] = dl::Mat4f{  sx, 0, 0, 0, 
+                                         0, sy, 0, 0, 
+                                         0, 0, sz, 0, 
+                                         static_cast<float>(box.x) + sx*0.5f,
+                                         static_cast<float>(box.y) + sy*0.5f,
+                                         static_cast<float>(box.z) + sz*0.5f, 1 };
+        }
     });
-    
-    bot_thread.join();
-    
-    std::cout << "Bot shutting down, stopping worker thread..." << std::endl;
-    work_queue.requestShutdown();
-    worker.join();
-    
-    return 0;
 }
 
-//==============================================================================
-// VMAX MODEL PROCESSING FUNCTIONS
-//==============================================================================
+/**
+ * Reads the conversion switches from the command line
+ * --costmodel is instance,quad,mesh; missing or invalid weights keep their defaults
+ */
+ConvertOptions convertOptionsFromArgs(dl::Args& args) {
+    ConvertOptions options;
+    if (args.have("--mode")) {
+        options.mode = args.value("--mode").buf();
+    }
+    options.greedy_box = args.have("--greedybox");
+    options.chunk_instancers = args.have("--chunkinstancers");
+    options.dedup_chunks = args.have("--dedupchunks");
+    options.bevel = args.have("--bevel");
+    options.flatten_groups = args.have("--flattengroups");
+    if (args.have("--debugdir")) {
+        options.debug_dir = args.value("--debugdir").buf();
+    }
+    options.write_intermediate = args.have("--intermediate");
+    if (options.write_intermediate && options.debug_dir.empty()) {
+        options.debug_dir = "vmax_debug";
+    }
+    if (args.have("--modelcache")) {
+        options.model_cache_dir = args.value("--modelcache").buf();
+    }
+    if (args.have("--modelcachesize")) {
+        long long megabytes = std::atoll(args.value("--modelcachesize").buf());
+        if (megabytes > 0) {
+            options.model_cache_max_bytes = static_cast<uint64_t>(megabytes) << 20;
+        }
+    }
+    options.adaptive_quality = !args.have("--fixedquality");
+    if (args.have("--qualityfloor")) {
+        int minResolution = 0, maxTargetNoise = 0, minTimeBudget = 0, minFrameBudget = 0;
+        int parsed = std::sscanf(args.value("--qualityfloor").buf(), "%d,%d,%d,%d", &minResolution, &maxTargetNoise, &minTimeBudget, &minFrameBudget);
+        if (parsed >= 1 && minResolution > 0) options.quality_floor.min_resolution = minResolution;
+        if (parsed >= 2 && maxTargetNoise > 0) options.quality_floor.max_target_noise = maxTargetNoise;
+        if (parsed >= 3 && minTimeBudget > 0) options.quality_floor.min_time_budget = minTimeBudget;
+        if (parsed >= 4 && minFrameBudget > 0) options.quality_floor.min_frame_budget = minFrameBudget;
+    }
+    if (args.have("--preview")) {
+        options.preview_size = std::max(0, std::atoi(args.value("--preview").buf()));
+    }
 
-dl::bella_sdk::Node addModelToScene(dl::Args& args,
-                                    dl::bella_sdk::Scene& belScene, 
-                                    dl::bella_sdk::Node& belWorld, 
-                                    const oom::vmax::Model& vmaxModel, 
-                                    const std::vector<oom::vmax::RGBA>& vmaxPalette, 
-                                    const std::array<oom::vmax::Material, 8>& vmaxMaterial) {
-    // Create Bella scene nodes for each voxel
-    int i = 0;
-    dl::String modelName = dl::String(vmaxModel.vmaxbFileName.c_str());
-    dl::String canonicalName = modelName.replace(".vmaxb", "");
-    dl::bella_sdk::Node belCanonicalNode;
-    {
-        dl::bella_sdk::Scene::EventScope es(belScene);
+    if (args.have("--costmodel")) {
+        double perInstance = 0.0, perQuad = 0.0, perMeshNode = 0.0;
+        int parsed = std::sscanf(args.value("--costmodel").buf(), "%lf,%lf,%lf", &perInstance, &perQuad, &perMeshNode);
+        if (parsed >= 1 && perInstance > 0.0) options.cost_model.per_instance = perInstance;
+        if (parsed >= 2 && perQuad > 0.0) options.cost_model.per_quad = perQuad;
+        if (parsed >= 3 && perMeshNode >= 0.0) options.cost_model.per_mesh_node = perMeshNode;
+    }
+    return options;
+}
 
-        auto belVoxel = belScene.findNode("oomVoxel");
-        auto belLiqVoxel = belScene.findNode("oomLiqVoxel");
-        auto belMeshVoxel = belScene.findNode("oomMeshVoxel");
-        auto belVoxelForm = belScene.findNode("oomEmitterBlockXform");
-        auto belBevel = belScene.findNode("oomBevel");
+/**
+ * Load governor: picks sample quality, resolution and a wall clock budget for one job
+ * Queue depth sets the starting tier, a heavy scene or a long orbit drops one more, and
+ * the result is clamped to the configured floors so a full queue never renders garbage.
+ * A quality= tier from the upload message replaces the queue-based pick when it is cheaper,
+ * or for admins (mayRaiseQuality) in either direction. Orbits split the budget across frames.
+ */
+RenderTier chooseRenderTier(const ConvertOptions& options, 
+                            const std::string& requestedTier, 
+                            bool mayRaiseQuality, 
+                            int queueDepth, 
+                            const SceneBuildStats& stats, 
+                            int orbitFrames, 
+                            const dl::Vec2& baseResolution) {
+    static const RenderTier tiers[] = {
+        {"full",     1.0,  0,  0},
+        {"balanced", 0.75, 15, 120},
+        {"fast",     0.5,  25, 45},
+        {"rush",     0.35, 40, 20},
+    };
+    constexpr int tierCount = sizeof(tiers) / sizeof(tiers[0]);
 
-        auto modelXform = belScene.createNode("xform", canonicalName, canonicalName);
-        modelXform["steps"][0]["xform"] = dl::Mat4 {1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1};
-        for (const auto& [material, colorID] : vmaxModel.getUsedMaterialsAndColors()) {
-            for (int color : colorID) {
+    int requestedLevel = -1;
+    for (int i = 0; i < tierCount; i++) {
+        if (tiers[i].name == requestedTier) {
+            requestedLevel = i;
+        }
+    }
+    if (!options.adaptive_quality && requestedLevel < 0) {
+        return tiers[0];
+    }
 
-                auto thisname = canonicalName + dl::String("Material") + dl::String(material) + dl::String("Color") + dl::String(color);
+    int level = 0;
+    size_t sceneCost = stats.instance_count + stats.mesh_quads;
+    if (options.adaptive_quality) {
+        level = queueDepth == 0 ? 0 : queueDepth <= 2 ? 1 : queueDepth <= 9 ? 2 : 3;
+        if (level > 0 && (sceneCost > 2000000 || orbitFrames > 60)) {
+            level++;
+        }
+    }
+    // quality= is not part of the request cost, so only admins may ask for more than the governor gives
+    if (requestedLevel >= 0) {
+        if (requestedLevel < level && !mayRaiseQuality) {
+            std::cout << "🎚️ quality=" << requestedTier << " is above the queue's tier, keeping " 
+                      << tiers[std::min(level, tierCount - 1)].name << std::endl;
+        } else {
+            level = requestedLevel;
+        }
+    }
+    RenderTier tier = tiers[std::min(level, tierCount - 1)];
 
-                auto belMaterial  = belScene.createNode("quickMaterial",
-                                canonicalName + dl::String("vmaxMat") + dl::String(material) + dl::String("Color") + dl::String(color));
-                bool isMesh = false;
-                bool isBox = true;
+    const QualityFloor& floor = options.quality_floor;
+    double longestSide = std::max(baseResolution.x, baseResolution.y);
+    if (longestSide * tier.resolution_scale < floor.min_resolution) {
+        tier.resolution_scale = std::min(1.0, floor.min_resolution / std::max(1.0, longestSide));
+    }
+    if (tier.target_noise > floor.max_target_noise) {
+        tier.target_noise = floor.max_target_noise;
+    }
+    if (orbitFrames > 0 && tier.time_budget > 0) {
+        // The tier budget covers the whole orbit, each frame gets its share down to the frame floor
+        tier.time_budget = std::max(floor.min_frame_budget, tier.time_budget / orbitFrames);
+    } else if (tier.time_budget > 0 && tier.time_budget < floor.min_time_budget) {
+        tier.time_budget = floor.min_time_budget;
+    }
 
-                if(material==7) {
-                    belMaterial["type"] = "liquid";
-                    belMaterial["liquidDepth"] = 300.0f;
-                    belMaterial["liquidIor"] = 1.33f;
-                    isMesh = true;
-                    isBox = false;
-                } else if(material==6 || vmaxPalette[color-1].a < 255) {
-                    belMaterial["type"] = "glass";
-                    belMaterial["roughness"] = vmaxMaterial[material].roughness * 100.0f;
-                    belMaterial["glassDepth"] = 500.0f;
-                } else if(vmaxMaterial[material].metalness > 0.1f) {
-                    belMaterial["type"] = "metal";
-                    belMaterial["roughness"] = vmaxMaterial[material].roughness * 100.0f;
-                } else if(vmaxMaterial[material].transmission > 0.0f) {
-                    belMaterial["type"] = "dielectric";
-                    belMaterial["transmission"] = vmaxMaterial[material].transmission;
-                } else if(vmaxMaterial[material].emission > 0.0f) {
-                    belMaterial["type"] = "emitter";
-                    belMaterial["emitterUnit"] = "radiance";
-                    belMaterial["emitterEnergy"] = vmaxMaterial[material].emission*100.0f;
-                } else if(vmaxMaterial[material].roughness > 0.8999f) {
-                    belMaterial["type"] = "diffuse";
-                } else {
-                    belMaterial["type"] = "plastic";
-                    belMaterial["roughness"] = vmaxMaterial[material].roughness * 100.0f;
-                }
+    std::cout << "🎚️ Quality tier " << tier.name << " (queue " << queueDepth << ", scene cost " << sceneCost 
+              << "): " << static_cast<int>(tier.resolution_scale * 100) << "% resolution, noise " 
+              << tier.target_noise << ", budget " << tier.time_budget << "s" << std::endl;
+    return tier;
+}
+
+/**
+ * Cost model for --mode auto: compares the instancer against the mesh of one
+ * material/color bucket before the mesh is built. face_runs only estimates the greedy
+ * mesher's quad count: a run can be split where the rows beside it differ, so the mesh may
+ * have more quads (exposed_faces is the hard upper bound). Meshed buckets log their real
+ * quad count next to the estimate. Small scattered buckets have a high surface-to-volume
+ * ratio and few instances, so the fixed mesh overhead loses; large solid buckets have few
+ * runs per voxel. Inputs and the decision are logged so the weights can be tuned from real jobs.
+ */
+bool preferMeshForBucket(const BucketCostModel& costModel, 
+                         const dl::String& bucketName, 
+                         size_t voxelCount, 
+                         size_t instanceCount, 
+                         const BucketSurface& surface) {
+    double surfaceToVolume = voxelCount > 0 ? static_cast<double>(surface.exposed_faces) / (6.0 * voxelCount) : 0.0;
+    double boxCost = costModel.per_instance * instanceCount;
+    double meshCost = costModel.per_mesh_node + costModel.per_quad * surface.face_runs;
+    bool preferMesh = meshCost < boxCost;
+
+    std::cout << "⚖️ " << bucketName.buf() 
+              << " voxels=" << voxelCount 
+              << " surface/volume=" << surfaceToVolume 
+              << " instances=" << instanceCount 
+              << " faces=" << surface.exposed_faces 
+              << " runs=" << surface.face_runs 
+              << " cost box=" << boxCost 
+              << " mesh=" << meshCost 
+              << " -> " << (preferMesh ? "mesh" : "box") << std::endl;
+    return preferMesh;
+}
+
+/**
+ * Counts the exposed faces of one bucket and the runs they form along the mesher's u axis
+ * Same occupancy grid as greedyMeshFromVoxels, but no masks, merging or welding
+ */
+BucketSurface measureBucketSurface(const std::vector<oom::vmax::Voxel>& voxels) {
+    BucketSurface surface;
+    if (voxels.empty()) {
+        return surface;
+    }
+
+    int minC[3] = { voxels[0].x, voxels[0].y, voxels[0].z };
+    int maxC[3] = { minC[0], minC[1], minC[2] };
+    for (const auto& voxel : voxels) {
+        const int c[3] = { voxel.x, voxel.y, voxel.z };
+        for (int a = 0; a < 3; a++) {
+            minC[a] = std::min(minC[a], c[a]);
+            maxC[a] = std::max(maxC[a], c[a]);
+        }
+    }
+    const int dim[3] = { maxC[0] - minC[0] + 1, maxC[1] - minC[1] + 1, maxC[2] - minC[2] + 1 };
+
+    std::vector<uint8_t> grid(static_cast<size_t>(dim[0]) * dim[1] * dim[2], 0);
+    auto filled = [&](const int p[3]) -> bool {
+        if (p[0] < 0 || p[1] < 0 || p[2] < 0 || p[0] >= dim[0] || p[1] >= dim[1] || p[2] >= dim[2]) {
+            return false;
+        }
+        return grid[(static_cast<size_t>(p[2]) * dim[1] + p[1]) * dim[0] + p[0]] != 0;
+    };
+    for (const auto& voxel : voxels) {
+        grid[(static_cast<size_t>(voxel.z - minC[2]) * dim[1] + (voxel.y - minC[1])) * dim[0] + (voxel.x - minC[0])] = 1;
+    }
 
-                if (args.have("bevel") && material != 7) {
-                    belMaterial["bevel"] = belBevel;
+    for (const auto& voxel : voxels) {
+        const int p[3] = { voxel.x - minC[0], voxel.y - minC[1], voxel.z - minC[2] };
+        for (int d = 0; d < 3; d++) {
+            const int u = (d + 1) % 3;
+            for (int dir = -1; dir <= 1; dir += 2) {
+                int n[3] = { p[0], p[1], p[2] };
+                n[d] += dir;
+                if (filled(n)) {
+                    continue;
                 }
-                if (args.have("mode") && args.value("mode") == "mesh" || args.value("mode") == "both") {
-                    isMesh = true;
-                    isBox = false;
+                surface.exposed_faces++;
+
+                // A run starts where the previous cell along u has no face in this direction
+                int prev[3] = { p[0], p[1], p[2] };
+                prev[u] -= 1;
+                int prevFront[3] = { prev[0], prev[1], prev[2] };
+                prevFront[d] += dir;
+                if (!filled(prev) || filled(prevFront)) {
+                    surface.face_runs++;
                 }
+            }
+        }
+    }
+    return surface;
+}
 
-                // Convert 0-255 to 0-1 , remember to -1 color index becuase voxelmax needs 0 to indicate no voxel
-                double bellaR = static_cast<double>(vmaxPalette[color-1].r)/255.0;
-                double bellaG = static_cast<double>(vmaxPalette[color-1].g)/255.0;
-                double bellaB = static_cast<double>(vmaxPalette[color-1].b)/255.0;
-                double bellaA = static_cast<double>(vmaxPalette[color-1].a)/255.0;
-                belMaterial["color"] = dl::Rgba{
-                    oom::misc::srgbToLinear(bellaR), 
-                    oom::misc::srgbToLinear(bellaG), 
-                    oom::misc::srgbToLinear(bellaB), 
-                    bellaA
-                };
+/**
+ * Greedily merges voxels into axis-aligned boxes: grow along x, then y, then z
+ * while every cell of the grown face is filled and not yet claimed.
+ * Voxels are expected to belong to a single material/color bucket.
+ */
+std::vector<VoxelBox> greedyBoxesFromVoxels(const std::vector<oom::vmax::Voxel>& voxels) {
+    std::vector<VoxelBox> boxes;
+    if (voxels.empty()) {
+        return boxes;
+    }
 
-                // Get all voxels for this material/color combination
-                const std::vector<oom::vmax::Voxel>& voxelsOfType = vmaxModel.getVoxels(material, color);
-                int showchunk =0;
+    // Dense occupancy grid over the bucket's own bounds
+    int minX = voxels[0].x, minY = voxels[0].y, minZ = voxels[0].z;
+    int maxX = minX, maxY = minY, maxZ = minZ;
+    for (const auto& voxel : voxels) {
+        minX = std::min(minX, static_cast<int>(voxel.x));
+        minY = std::min(minY, static_cast<int>(voxel.y));
+        minZ = std::min(minZ, static_cast<int>(voxel.z));
+        maxX = std::max(maxX, static_cast<int>(voxel.x));
+        maxY = std::max(maxY, static_cast<int>(voxel.y));
+        maxZ = std::max(maxZ, static_cast<int>(voxel.z));
+    }
+    const int dimX = maxX - minX + 1;
+    const int dimY = maxY - minY + 1;
+    const int dimZ = maxZ - minZ + 1;
 
-                if (isMesh) {
-                    auto belMeshXform  = belScene.createNode("xform",
-                        thisname+dl::String("Xform"));
-                    belMeshXform.parentTo(modelXform);
+    // 0 = empty, 1 = filled, 2 = already part of a box
+    std::vector<uint8_t> grid(static_cast<size_t>(dimX) * dimY * dimZ, 0);
+    auto cell = [&](int x, int y, int z) -> uint8_t& {
+        return grid[(static_cast<size_t>(z) * dimY + y) * dimX + x];
+    };
+    for (const auto& voxel : voxels) {
+        cell(voxel.x - minX, voxel.y - minY, voxel.z - minZ) = 1;
+    }
+
+    for (int z = 0; z < dimZ; z++) {
+        for (int y = 0; y < dimY; y++) {
+            for (int x = 0; x < dimX; x++) {
+                if (cell(x, y, z) != 1) {
+                    continue;
+                }
+
+                int sx = 1;
+                while (x + sx < dimX && cell(x + sx, y, z) == 1) {
+                    sx++;
+                }
 
-                    // Convert voxels of a particular color to ogt_vox_model
-                    ogt_vox_model* ogt_model = oom::ogt::convert_voxelsoftype_to_ogt_vox(voxelsOfType);
-                    ogt_mesh_rgba* palette = new ogt_mesh_rgba[256];
-                    for (int i = 0; i < 256; i++) {
-                        palette[i] = ogt_mesh_rgba{vmaxPalette[i].r, vmaxPalette[i].g, vmaxPalette[i].b, vmaxPalette[i].a};
+                int sy = 1;
+                while (y + sy < dimY) {
+                    bool rowFilled = true;
+                    for (int i = 0; i < sx && rowFilled; i++) {
+                        rowFilled = cell(x + i, y + sy, z) == 1;
                     }
-                    ogt_voxel_meshify_context ctx = {};
-
-                    // Convert ogt voxels to mesh
-                    ogt_mesh* mesh = ogt_mesh_from_paletted_voxels_simple(  &ctx,
-                                                                            ogt_model->voxel_data, 
-                                                                            ogt_model->size_x, 
-                                                                            ogt_model->size_y, 
-                                                                            ogt_model->size_z, 
-                                                                            palette ); 
-                        
-                    if (voxelsOfType.size() > 0) {
-                        auto belMesh = add_ogt_mesh_to_scene(   thisname,
-                                                                mesh,
-                                                                belScene,
-                                                                belWorld
-                                                            );
-                        belMesh.parentTo(belMeshXform);
-                        belMeshXform["material"] = belMaterial;
-                    } else { 
-                        std::cout << "skipping" << color << "\n";
+                    if (!rowFilled) break;
+                    sy++;
+                }
+
+                int sz = 1;
+                while (z + sz < dimZ) {
+                    bool slabFilled = true;
+                    for (int j = 0; j < sy && slabFilled; j++) {
+                        for (int i = 0; i < sx && slabFilled; i++) {
+                            slabFilled = cell(x + i, y + j, z + sz) == 1;
+                        }
                     }
+                    if (!slabFilled) break;
+                    sz++;
                 }
-                if (isBox) {
-                    auto belInstancer  = belScene.createNode("instancer",
-                        thisname);
-                    auto xformsArray = dl::ds::Vector<dl::Mat4f>();
-                    belInstancer["steps"][0]["xform"] = dl::Mat4 {1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1};
-                    belInstancer.parentTo(modelXform);
-
-                    for (const auto& eachvoxel : voxelsOfType) {
-                        xformsArray.push_back( dl::Mat4f{  1, 0, 0, 0, 
-                                                        0, 1, 0, 0, 
-                                                        0, 0, 1, 0, 
-                                                        (static_cast<float>(eachvoxel.x))+0.5f,
-                                                        (static_cast<float>(eachvoxel.y))+0.5f,
-                                                        (static_cast<float>(eachvoxel.z))+0.5f, 1 });
-                    };
-                    belInstancer["steps"][0]["instances"] = xformsArray;
-                    belInstancer["material"] = belMaterial;
-                    if(material==7) {
-                        belLiqVoxel.parentTo(belInstancer);
-                    } else {
-                        belMeshVoxel.parentTo(belInstancer);
+
+                for (int k = 0; k < sz; k++) {
+                    for (int j = 0; j < sy; j++) {
+                        for (int i = 0; i < sx; i++) {
+                            cell(x + i, y + j, z + k) = 2;
+                        }
+                    }
+                }
+                boxes.push_back(VoxelBox{ x + minX, y + minY, z + minZ, sx, sy, sz });
+            }
+        }
+    }
+    return boxes;
+}
+
+/**
+ * Greedy mesher for a single material/color bucket
+ * For each of the 6 face directions and each slice along that axis, builds a 2D mask
+ * of exposed faces and merges it into maximal rectangles, emitting one quad per rectangle.
+ * Corners are welded through a hash of their integer coordinates.
+ */
+VoxelQuadMesh greedyMeshFromVoxels(const std::vector<oom::vmax::Voxel>& voxels) {
+    VoxelQuadMesh mesh;
+    if (voxels.empty()) {
+        return mesh;
+    }
+
+    int minC[3] = { voxels[0].x, voxels[0].y, voxels[0].z };
+    int maxC[3] = { minC[0], minC[1], minC[2] };
+    for (const auto& voxel : voxels) {
+        const int c[3] = { voxel.x, voxel.y, voxel.z };
+        for (int a = 0; a < 3; a++) {
+            minC[a] = std::min(minC[a], c[a]);
+            maxC[a] = std::max(maxC[a], c[a]);
+        }
+    }
+    const int dim[3] = { maxC[0] - minC[0] + 1, maxC[1] - minC[1] + 1, maxC[2] - minC[2] + 1 };
+
+    std::vector<uint8_t> grid(static_cast<size_t>(dim[0]) * dim[1] * dim[2], 0);
+    auto filled = [&](const int p[3]) -> bool {
+        if (p[0] < 0 || p[1] < 0 || p[2] < 0 || p[0] >= dim[0] || p[1] >= dim[1] || p[2] >= dim[2]) {
+            return false;
+        }
+        return grid[(static_cast<size_t>(p[2]) * dim[1] + p[1]) * dim[0] + p[0]] != 0;
+    };
+    for (const auto& voxel : voxels) {
+        grid[(static_cast<size_t>(voxel.z - minC[2]) * dim[1] + (voxel.y - minC[1])) * dim[0] + (voxel.x - minC[0])] = 1;
+    }
+
+    // Weld corners, grid corners span [0, dim] on each axis
+    std::unordered_map<uint64_t, uint32_t> pointIndex;
+    pointIndex.reserve(voxels.size());
+    auto weld = [&](const int p[3]) -> uint32_t {
+        uint64_t key = (static_cast<uint64_t>(p[2]) << 42) | (static_cast<uint64_t>(p[1]) << 21) | static_cast<uint64_t>(p[0]);
+        auto [it, inserted] = pointIndex.emplace(key, static_cast<uint32_t>(mesh.points.size()));
+        if (inserted) {
+            mesh.points.push_back({ p[0] + minC[0], p[1] + minC[1], p[2] + minC[2] });
+        }
+        return it->second;
+    };
+
+    std::vector<uint8_t> mask;
+    for (int d = 0; d < 3; d++) {
+        // (d, u, v) is a cyclic permutation so u x v points along +d
+        const int u = (d + 1) % 3;
+        const int v = (d + 2) % 3;
+        mask.assign(static_cast<size_t>(dim[u]) * dim[v], 0);
+
+        for (int side = 0; side < 2; side++) {
+            const int dir = side == 0 ? 1 : -1;
+
+            for (int slice = 0; slice < dim[d]; slice++) {
+                // Exposed faces of this slice facing dir
+                bool any = false;
+                for (int j = 0; j < dim[v]; j++) {
+                    for (int i = 0; i < dim[u]; i++) {
+                        int p[3];
+                        p[d] = slice; p[u] = i; p[v] = j;
+                        int n[3] = { p[0], p[1], p[2] };
+                        n[d] += dir;
+                        uint8_t exposed = filled(p) && !filled(n);
+                        mask[static_cast<size_t>(j) * dim[u] + i] = exposed;
+                        any = any || exposed;
+                        mesh.exposed_faces += exposed;
                     }
-                    if(vmaxMaterial[material].emission > 0.0f) {
-                        belVoxelForm.parentTo(belInstancer);
+                }
+                if (!any) {
+                    continue;
+                }
+
+                const int plane = dir > 0 ? slice + 1 : slice;
+                for (int j = 0; j < dim[v]; j++) {
+                    for (int i = 0; i < dim[u]; ) {
+                        if (!mask[static_cast<size_t>(j) * dim[u] + i]) {
+                            i++;
+                            continue;
+                        }
+
+                        int w = 1;
+                        while (i + w < dim[u] && mask[static_cast<size_t>(j) * dim[u] + i + w]) {
+                            w++;
+                        }
+                        int h = 1;
+                        while (j + h < dim[v]) {
+                            bool rowFilled = true;
+                            for (int k = 0; k < w && rowFilled; k++) {
+                                rowFilled = mask[static_cast<size_t>(j + h) * dim[u] + i + k] != 0;
+                            }
+                            if (!rowFilled) break;
+                            h++;
+                        }
+                        for (int l = 0; l < h; l++) {
+                            std::fill_n(mask.begin() + static_cast<size_t>(j + l) * dim[u] + i, w, 0);
+                        }
+
+                        int c0[3], c1[3], c2[3], c3[3];
+                        c0[d] = c1[d] = c2[d] = c3[d] = plane;
+                        c0[u] = i;     c0[v] = j;
+                        c1[u] = i + w; c1[v] = j;
+                        c2[u] = i + w; c2[v] = j + h;
+                        c3[u] = i;     c3[v] = j + h;
+                        if (dir > 0) {
+                            mesh.quads.push_back({ weld(c0), weld(c1), weld(c2), weld(c3) });
+                        } else {
+                            mesh.quads.push_back({ weld(c0), weld(c3), weld(c2), weld(c1) });
+                        }
+                        i += w;
                     }
                 }
             }
         }
-        return modelXform;
     }
-    return dl::bella_sdk::Node();
+    return mesh;
 }
 
-dl::bella_sdk::Node add_ogt_mesh_to_scene(  dl::String name, 
-                                            ogt_mesh* meshmesh, 
-                                            dl::bella_sdk::Scene& belScene, 
-                                            dl::bella_sdk::Node& belWorld ) {
+/**
+ * Groups voxels by the 32x32x32 VoxelMax chunk they fall in
+ * Keys are the Morton code of the chunk coordinates, so iteration follows the same
+ * Z-order curve VoxelMax uses for chunk ids and neighbouring chunks stay adjacent
+ */
+std::map<uint32_t, std::vector<oom::vmax::Voxel>> splitVoxelsByChunk(const std::vector<oom::vmax::Voxel>& voxels) {
+    auto spreadBits = [](uint32_t v) -> uint32_t {
+        v &= 0x3ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8))  & 0x0300f00f;
+        v = (v | (v << 4))  & 0x030c30c3;
+        v = (v | (v << 2))  & 0x09249249;
+        return v;
+    };
 
-    auto ogtMesh = belScene.createNode("mesh", name+"ogtmesh", name+"ogtmesh");
-    ogtMesh["normals"] = "flat";
-    // Add vertices and faces to the mesh
-    dl::ds::Vector<dl::Pos3f> verticesArray;
-    for (uint32_t i = 0; i < meshmesh->vertex_count; i++) {
-        const auto& vertex = meshmesh->vertices[i];
-        uint32_t xx = static_cast<uint32_t>(vertex.pos.x);
-        uint32_t yy = static_cast<uint32_t>(vertex.pos.y);
-        uint32_t zz = static_cast<uint32_t>(vertex.pos.z);
-        verticesArray.push_back(dl::Pos3f{ static_cast<float>(xx), 
-                                            static_cast<float>(yy), 
-                                            static_cast<float>(zz) });
+    std::map<uint32_t, std::vector<oom::vmax::Voxel>> chunks;
+    for (const auto& voxel : voxels) {
+        uint32_t morton = spreadBits(static_cast<uint32_t>(voxel.x) >> 5) 
+                        | (spreadBits(static_cast<uint32_t>(voxel.y) >> 5) << 1) 
+                        | (spreadBits(static_cast<uint32_t>(voxel.z) >> 5) << 2);
+        chunks[morton].push_back(voxel);
+    }
+    return chunks;
+}
 
+/**
+ * Packs a decoded chunk relative to its 32x32x32 origin and hashes the content
+ * Packing is x | y<<5 | z<<10 | material<<15 | color<<18, sorted so decode order does not matter
+ * A snapshot whose voxels do not all fall in one aligned chunk is left in voxels and not deduplicated
+ */
+std::optional<DecodedChunk> decodeChunkForDedup(const oom::vmax::ChunkInfo& chunkInfo, std::vector<oom::vmax::Voxel>& voxels) {
+    if (voxels.empty()) {
+        return std::nullopt;
+    }
+    const std::array<int, 3> origin = { voxels[0].x & ~31, voxels[0].y & ~31, voxels[0].z & ~31 };
+    for (const auto& voxel : voxels) {
+        if ((voxel.x & ~31) != origin[0] || (voxel.y & ~31) != origin[1] || (voxel.z & ~31) != origin[2]) {
+            return std::nullopt;
+        }
     }
 
-    ogtMesh["steps"][0]["points"] = verticesArray;
+    DecodedChunk chunk;
+    chunk.info = chunkInfo;
+    chunk.voxels = std::move(voxels);
+    chunk.origin = origin;
 
-    dl::ds::Vector<dl::Vec4u> facesArray;
-    for (size_t i = 0; i < meshmesh->index_count; i+=3) {
-        facesArray.push_back(dl::Vec4u{ static_cast<unsigned int>(meshmesh->indices[i]), 
-                                        static_cast<unsigned int>(meshmesh->indices[i+1]), 
-                                        static_cast<unsigned int>(meshmesh->indices[i+2]), 
-                                        static_cast<unsigned int>(meshmesh->indices[i+2]) });
-    }
-    ogtMesh["polygons"] = facesArray;
-    return ogtMesh;
-}
\ No newline at end of file
+    chunk.packed.reserve(chunk.voxels.size());
+    for (const auto& voxel : chunk.voxels) {
+        chunk.packed.push_back(  static_cast<uint32_t>(voxel.x - chunk.origin[0]) 
+                              | (static_cast<uint32_t>(voxel.y - chunk.origin[1]) << 5) 
+                              | (static_cast<uint32_t>(voxel.z - chunk.origin[2]) << 10) 
+                              | (static_cast<uint32_t>(voxel.material & 7) << 15) 
+                              | (static_cast<uint32_t>(voxel.palette) << 18));
+    }
+    std::sort(chunk.packed.begin(), chunk.packed.end());
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (uint32_t value : chunk.packed) {
+        for (int b = 0; b < 4; b++) {
+            hash ^= (value >> (b * 8)) & 0xff;
+            hash *= 1099511628211ULL;
+        }
+    }
+    chunk.hash = hash;
+    return chunk;
+}
+
+/**
+ * Groups a model's decoded chunks by content. Chunks seen once go straight into the model;
+ * content seen more than once becomes a RepeatedChunk that is built once and instanced.
+ * Hash matches are confirmed on the packed voxels so collisions never merge different chunks.
+ */
+std::vector<RepeatedChunk> dedupModelChunks(std::vector<DecodedChunk>& chunks, 
+                                            oom::vmax::Model& model, 
+                                            SceneBuildStats& stats) {
+    std::vector<RepeatedChunk> repeated;
+    std::unordered_map<uint64_t, std::vector<size_t>> groupsByHash;
+    std::vector<std::vector<size_t>> groups;
+
+    for (size_t i = 0; i < chunks.size(); i++) {
+        auto& candidates = groupsByHash[chunks[i].hash];
+        bool placed = false;
+        for (size_t g : candidates) {
+            if (chunks[groups[g].front()].packed == chunks[i].packed) {
+                groups[g].push_back(i);
+                placed = true;
+                break;
+            }
+        }
+        if (!placed) {
+            candidates.push_back(groups.size());
+            groups.push_back({ i });
+        }
+    }
+
+    std::string baseName = model.vmaxbFileName;
+    if (baseName.size() > 6 && baseName.substr(baseName.size() - 6) == ".vmaxb") {
+        baseName = baseName.substr(0, baseName.size() - 6);
+    }
+
+    for (const auto& group : groups) {
+        stats.chunk_count += group.size();
+        const DecodedChunk& canonical = chunks[group.front()];
+
+        if (group.size() == 1) {
+            for (const auto& voxel : canonical.voxels) {
+                model.addVoxel(voxel.x, voxel.y, voxel.z, voxel.material, voxel.palette, canonical.info.id, canonical.info.mortoncode);
+            }
+            continue;
+        }
+
+        stats.deduplicated_chunks += group.size() - 1;
+        repeated.emplace_back(baseName + "_chunk" + std::to_string(repeated.size()) + ".vmaxb");
+        RepeatedChunk& repeatedChunk = repeated.back();
+        for (const auto& voxel : canonical.voxels) {
+            repeatedChunk.model.addVoxel(voxel.x - canonical.origin[0], 
+                                         voxel.y - canonical.origin[1], 
+                                         voxel.z - canonical.origin[2], 
+                                         voxel.material, voxel.palette, 0, 0);
+        }
+        for (size_t i : group) {
+            repeatedChunk.origins.push_back(chunks[i].origin);
+        }
+    }
+    return repeated;
+}